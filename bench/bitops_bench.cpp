@@ -0,0 +1,124 @@
+// BITCOUNT / BITOP over a large bitmap and PFMERGE-style register merging, comparing the
+// dispatched kernels in BitOps.cpp with a plain byte loop.
+//
+// Usage: bench_bitops [bitmap_mb] [sketches]
+
+#include "BitOps.h"
+#include "HyperLogLog.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Reference implementations: one byte at a time, the way the commands would be written without kernels
+static uint64_t naive_count(const uint8_t* data, size_t length) {
+    static const auto table = []() {
+        std::array<uint8_t, 256> bits{};
+        for(int i = 1; i < 256; ++i) {
+            bits[i] = static_cast<uint8_t>(bits[i >> 1] + (i & 1));
+        }
+        return bits;
+    }();
+    uint64_t bits = 0;
+    for(size_t i = 0; i < length; ++i) {
+        bits += table[data[i]];
+    }
+    return bits;
+}
+
+static void naive_and(uint8_t* dst, const uint8_t* src, size_t length) {
+    for(size_t i = 0; i < length; ++i) {
+        dst[i] &= src[i];
+    }
+}
+
+static void naive_max(uint8_t* dst, const uint8_t* src, size_t length) {
+    for(size_t i = 0; i < length; ++i) {
+        if(src[i] > dst[i]) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+// Best of three runs, in milliseconds
+template <typename Fn>
+static double time_ms(Fn fn) {
+    double best = 1e300;
+    for(int round = 0; round < 3; ++round) {
+        auto start = Clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+static void report(const char* name, size_t bytes, double naive, double dispatched) {
+    std::printf("%-10s naive=%9.2f ms (%6.2f GB/s)  kernel=%9.2f ms (%6.2f GB/s)  speedup=%5.1fx\n",
+                name, naive, bytes / naive / 1e6, dispatched, bytes / dispatched / 1e6, naive / dispatched);
+}
+
+int main(int argc, char** argv) {
+    size_t bitmap_mb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 512;
+    int sketches = argc > 2 ? std::atoi(argv[2]) : 1000;
+    size_t bytes = bitmap_mb << 20;
+
+    std::mt19937_64 rng(42);
+    std::vector<uint8_t> a(bytes);
+    std::vector<uint8_t> b(bytes);
+    for(size_t i = 0; i + 8 <= bytes; i += 8) {
+        uint64_t word = rng();
+        std::copy_n(reinterpret_cast<uint8_t*>(&word), 8, &a[i]);
+        word = rng();
+        std::copy_n(reinterpret_cast<uint8_t*>(&word), 8, &b[i]);
+    }
+
+    std::printf("%zu MB bitmaps\n", bitmap_mb);
+    uint64_t naive_bits = 0;
+    uint64_t kernel_bits = 0;
+    double naive = time_ms([&]() { naive_bits = naive_count(a.data(), bytes); });
+    double dispatched = time_ms([&]() { kernel_bits = bit_count(a.data(), bytes); });
+    report("BITCOUNT", bytes, naive, dispatched);
+    if(naive_bits != kernel_bits) {
+        std::printf("BITCOUNT mismatch: %llu != %llu\n", (unsigned long long)naive_bits, (unsigned long long)kernel_bits);
+        return 1;
+    }
+
+    // BITOP AND in place; repeating it leaves the result unchanged, so every run does the same work
+    naive = time_ms([&]() { naive_and(a.data(), b.data(), bytes); });
+    dispatched = time_ms([&]() { bit_op(BitOp::And, a.data(), b.data(), bytes); });
+    report("BITOP AND", bytes, naive, dispatched);
+
+    // PFMERGE of many dense sketches: one register max per sketch
+    std::vector<std::string> dense(sketches);
+    for(int i = 0; i < sketches; ++i) {
+        std::vector<uint8_t> registers(HyperLogLog::HLL_REGISTERS);
+        for(uint8_t& reg : registers) {
+            reg = static_cast<uint8_t>(rng() % 8);
+        }
+        HyperLogLog::store_dense(dense[i], registers.data());
+    }
+    std::vector<uint8_t> merged(HyperLogLog::HLL_REGISTERS);
+    size_t merge_bytes = static_cast<size_t>(sketches) * HyperLogLog::HLL_REGISTERS;
+    naive = time_ms([&]() {
+        std::fill(merged.begin(), merged.end(), 0);
+        for(const std::string& sketch : dense) {
+            naive_max(merged.data(), reinterpret_cast<const uint8_t*>(sketch.data()) + HyperLogLog::HLL_HEADER_SIZE,
+                      HyperLogLog::HLL_REGISTERS);
+        }
+    });
+    dispatched = time_ms([&]() {
+        std::fill(merged.begin(), merged.end(), 0);
+        for(const std::string& sketch : dense) {
+            HyperLogLog::merge_into(merged.data(), sketch);
+        }
+    });
+    std::printf("%d dense sketches\n", sketches);
+    report("PFMERGE", merge_bytes, naive, dispatched);
+    return 0;
+}
@@ -0,0 +1,83 @@
+// Memory and latency of JSON-like values stored with value-compression off versus on.
+//
+// Usage: bench_compression [values] [gets]
+
+#include "KeyValueStore.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// A JSON array of user records, padded out to roughly size bytes
+static std::string make_blob(size_t size, std::mt19937_64& rng) {
+    static const char* const tags[] = {"admin", "beta", "staff", "trial", "vip"};
+    std::string blob = "[";
+    for(int id = 0; blob.size() < size; ++id) {
+        blob += "{\"id\":" + std::to_string(rng() % 1000000) + ",\"name\":\"user" + std::to_string(id) +
+                "\",\"active\":" + (rng() % 2 ? "true" : "false") + ",\"score\":" + std::to_string(rng() % 10000) +
+                ",\"tags\":[\"" + tags[rng() % 5] + "\",\"" + tags[rng() % 5] + "\"]},";
+    }
+    blob.back() = ']';
+    return blob;
+}
+
+static void run(const char* mode, bool compress, const std::vector<std::string>& blobs, int gets) {
+    KeyValueStore store;
+    store.set_compression(compress, 4096);
+
+    auto start = Clock::now();
+    for(size_t i = 0; i < blobs.size(); ++i) {
+        store.set("blob:" + std::to_string(i), blobs[i]);
+    }
+    double set_us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / blobs.size();
+
+    size_t original = 0;
+    for(const std::string& blob : blobs) {
+        original += blob.size();
+    }
+    CompressionStats stats = store.compression_stats();
+    size_t stored = original - stats.original_bytes + stats.stored_bytes;
+
+    std::mt19937_64 rng(7);
+    std::vector<double> latencies_us;
+    latencies_us.reserve(gets);
+    size_t checksum = 0;
+    for(int i = 0; i < gets; ++i) {
+        std::string key = "blob:" + std::to_string(rng() % blobs.size());
+        auto get_start = Clock::now();
+        checksum += store.get(key).size();
+        latencies_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - get_start).count());
+    }
+
+    std::sort(latencies_us.begin(), latencies_us.end());
+    auto percentile = [&](double p) {
+        return latencies_us[static_cast<size_t>(p * (latencies_us.size() - 1))];
+    };
+    std::printf("%-4s stored=%8.2f MB (%5.2fx)  SET=%6.2fus  GET p50=%6.2fus p99=%6.2fus  [%zu]\n",
+                mode, stored / 1048576.0, static_cast<double>(original) / stored, set_us,
+                percentile(0.50), percentile(0.99), checksum);
+}
+
+int main(int argc, char** argv) {
+    size_t values = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4096;
+    int gets = argc > 2 ? std::atoi(argv[2]) : 100000;
+
+    // Sizes spread evenly over 4KB to 64KB
+    std::mt19937_64 rng(42);
+    std::vector<std::string> blobs;
+    size_t total = 0;
+    for(size_t i = 0; i < values; ++i) {
+        blobs.push_back(make_blob(4096 + rng() % (60 * 1024), rng));
+        total += blobs.back().size();
+    }
+
+    std::printf("%zu JSON values of 4-64KB, %.2f MB in total\n", values, total / 1048576.0);
+    run("off", false, blobs, gets);
+    run("on", true, blobs, gets);
+    return 0;
+}
@@ -0,0 +1,85 @@
+// GET latency seen by another client while large values are deleted inline (DEL)
+// versus handed to the lazy-free thread (UNLINK). Deletions run back to back for the
+// whole sample, so the percentiles describe GETs that compete with them.
+//
+// GETs are issued on a fixed schedule and timed from when they were due, not from when
+// the reader got around to them. A closed loop would record a single slow GET per stall
+// and hide it below p99; here every GET that should have run during the stall counts.
+//
+// Usage: bench_lazyfree [value_mb] [seconds]
+
+#include "KeyValueStore.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::chrono::microseconds GET_INTERVAL(10);
+
+static void run(const char* mode, bool lazy, const std::string& big, double seconds) {
+    KeyValueStore store;
+    store.set("hot", "value");
+
+    std::atomic<bool> done{false};
+    std::vector<double> latencies_us;
+    latencies_us.reserve(1 << 24);
+
+    std::thread reader([&]() {
+        auto due = Clock::now();
+        while(!done) {
+            due += GET_INTERVAL;
+            while(Clock::now() < due) {
+            }
+            store.get("hot");
+            latencies_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - due).count());
+        }
+    });
+
+    // SET copies the value before taking the lock, so only the deletion contends with the reader
+    int deletions = 0;
+    double delete_ms = 0;
+    auto deadline = Clock::now() + std::chrono::duration<double>(seconds);
+    while(Clock::now() < deadline) {
+        store.set("big", big);
+        auto start = Clock::now();
+        if(lazy) {
+            store.unlink("big");
+        }
+        else {
+            store.del("big");
+        }
+        delete_ms += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        ++deletions;
+    }
+    done = true;
+    reader.join();
+
+    std::sort(latencies_us.begin(), latencies_us.end());
+    auto percentile = [&](double p) {
+        return latencies_us[static_cast<size_t>(p * (latencies_us.size() - 1))];
+    };
+    size_t stalled = latencies_us.end() - std::upper_bound(latencies_us.begin(), latencies_us.end(), 1000.0);
+    std::printf("%-7s deletions=%-4d avg delete=%7.2fms gets=%-9zu p50=%6.2fus p99=%8.2fus p99.9=%9.2fus "
+                "max=%9.2fus >1ms=%zu\n",
+                mode, deletions, delete_ms / deletions, latencies_us.size(), percentile(0.50),
+                percentile(0.99), percentile(0.999), latencies_us.back(), stalled);
+}
+
+int main(int argc, char** argv) {
+    size_t value_mb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+    double seconds = argc > 2 ? std::atof(argv[2]) : 5;
+
+    // Every copy touches all of its pages, so freeing it really has to return memory
+    std::string big(value_mb << 20, 'x');
+
+    std::printf("Deleting %zu MB values back to back for %.1fs while another thread runs GET\n", value_mb, seconds);
+    run("DEL", false, big, seconds);
+    run("UNLINK", true, big, seconds);
+    return 0;
+}
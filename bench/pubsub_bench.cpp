@@ -0,0 +1,111 @@
+// One publisher fanning out to many subscribers. Reports the time spent inside PUBLISH
+// (one encode plus one shared-buffer enqueue per subscriber) and the time until every
+// subscriber socket has received every message.
+//
+// Usage: bench_pubsub [subscribers] [messages] [payload_bytes]
+
+#include "PubSub.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+    size_t subscribers = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    size_t messages = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+    size_t payload_bytes = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 64;
+
+    // Two descriptors per subscriber
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if(subscribers * 2 + 64 > limit.rlim_cur) {
+        subscribers = (limit.rlim_cur - 64) / 2;
+        std::printf("Descriptor limit caps the run at %zu subscribers\n", subscribers);
+    }
+
+    int epoll_fd = epoll_create1(0);
+    std::vector<int> read_ends;
+    std::vector<std::shared_ptr<Subscriber>> clients;
+    PubSub& pubsub = PubSub::instance();
+
+    auto setup_start = Clock::now();
+    for(size_t i = 0; i < subscribers; ++i) {
+        int pair[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            std::perror("socketpair");
+            return 1;
+        }
+        read_ends.push_back(pair[0]);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = pair[0];
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pair[0], &event);
+
+        auto subscriber = std::make_shared<Subscriber>(pair[1]);
+        pubsub.subscribe(subscriber, "invalidate");
+        clients.push_back(std::move(subscriber));
+    }
+    double setup_ms = std::chrono::duration<double, std::milli>(Clock::now() - setup_start).count();
+
+    std::string payload(payload_bytes, 'p');
+    std::string channel = "invalidate";
+    size_t frame_bytes = std::string("*3\r\n$7\r\nmessage\r\n").size() +
+                         std::to_string(channel.size()).size() + channel.size() + 5 +
+                         std::to_string(payload.size()).size() + payload.size() + 5;
+    size_t expected_bytes = frame_bytes * messages * subscribers;
+
+    // Drain every subscriber socket on one thread
+    size_t received_bytes = 0;
+    Clock::time_point last_byte;
+    std::thread reader([&]() {
+        std::vector<epoll_event> events(1024);
+        char buffer[65536];
+        while(received_bytes < expected_bytes) {
+            int ready = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), 1000);
+            for(int i = 0; i < ready; ++i) {
+                ssize_t n = recv(events[i].data.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+                if(n > 0) {
+                    received_bytes += static_cast<size_t>(n);
+                }
+            }
+        }
+        last_byte = Clock::now();
+    });
+
+    auto start = Clock::now();
+    size_t receivers = 0;
+    for(size_t i = 0; i < messages; ++i) {
+        receivers += pubsub.publish(channel, payload);
+    }
+    double publish_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    reader.join();
+    double delivered_ms = std::chrono::duration<double, std::milli>(last_byte - start).count();
+
+    std::printf("subscribers=%zu messages=%zu payload=%zuB setup=%.0fms\n", subscribers, messages, payload_bytes, setup_ms);
+    std::printf("publish: %.1f ms total, %.1f us per PUBLISH, %.0f ns per receiver\n",
+                publish_ms, publish_ms * 1000 / messages, publish_ms * 1e6 / receivers);
+    std::printf("delivery: %.1f ms until all %zu frames were received (%.2f M frames/s)\n",
+                delivered_ms, receivers, receivers / delivered_ms / 1000);
+
+    for(const auto& subscriber : clients) {
+        pubsub.unsubscribe_all(subscriber);
+        subscriber->close();
+    }
+    clients.clear();
+    for(int fd : read_ends) {
+        close(fd);
+    }
+    close(epoll_fd);
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include "BitOps.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BITOPS_X86 1
+#endif
+
+static uint64_t bit_count_scalar(const uint8_t* data, size_t length) {
+    uint64_t count = 0;
+    size_t i = 0;
+    for(; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        count += __builtin_popcountll(word);
+    }
+    for(; i < length; ++i) {
+        count += __builtin_popcount(data[i]);
+    }
+    return count;
+}
+
+static void bit_op_scalar(BitOp op, uint8_t* dst, const uint8_t* src, size_t length) {
+    for(size_t i = 0; i < length; ++i) {
+        switch(op) {
+        case BitOp::And: dst[i] &= src[i]; break;
+        case BitOp::Or:  dst[i] |= src[i]; break;
+        case BitOp::Xor: dst[i] ^= src[i]; break;
+        case BitOp::Not: dst[i] = ~src[i]; break;
+        }
+    }
+}
+
+static void max_bytes_scalar(uint8_t* dst, const uint8_t* src, size_t length) {
+    for(size_t i = 0; i < length; ++i) {
+        if(src[i] > dst[i]) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+#ifdef BITOPS_X86
+__attribute__((target("popcnt")))
+static uint64_t bit_count_popcnt(const uint8_t* data, size_t length) {
+    return bit_count_scalar(data, length);
+}
+
+// Nibble lookup popcount (vpshufb) summed with vpsadbw
+__attribute__((target("avx2")))
+static uint64_t bit_count_avx2(const uint8_t* data, size_t length) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+
+    size_t i = 0;
+    while(i + 32 <= length) {
+        // Byte counters hold at most 8 per iteration, so flush to 64-bit lanes every 31 blocks
+        __m256i local = _mm256_setzero_si256();
+        for(int block = 0; block < 31 && i + 32 <= length; ++block, i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_mask));
+            __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask));
+            local = _mm256_add_epi8(local, _mm256_add_epi8(lo, hi));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(local, _mm256_setzero_si256()));
+    }
+
+    uint64_t count = static_cast<uint64_t>(_mm256_extract_epi64(total, 0)) +
+                     static_cast<uint64_t>(_mm256_extract_epi64(total, 1)) +
+                     static_cast<uint64_t>(_mm256_extract_epi64(total, 2)) +
+                     static_cast<uint64_t>(_mm256_extract_epi64(total, 3));
+    return count + bit_count_popcnt(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static void bit_op_avx2(BitOp op, uint8_t* dst, const uint8_t* src, size_t length) {
+    size_t i = 0;
+    const __m256i ones = _mm256_set1_epi8(-1);
+    for(; i + 32 <= length; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i r;
+        switch(op) {
+        case BitOp::And: r = _mm256_and_si256(a, b); break;
+        case BitOp::Or:  r = _mm256_or_si256(a, b); break;
+        case BitOp::Xor: r = _mm256_xor_si256(a, b); break;
+        default:         r = _mm256_xor_si256(b, ones); break;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), r);
+    }
+    bit_op_scalar(op, dst + i, src + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static void max_bytes_avx2(uint8_t* dst, const uint8_t* src, size_t length) {
+    size_t i = 0;
+    for(; i + 32 <= length; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_max_epu8(a, b));
+    }
+    max_bytes_scalar(dst + i, src + i, length - i);
+}
+#endif
+
+// Kernels are picked once, on first use, from the running CPU's features
+namespace {
+struct Kernels {
+    uint64_t (*count)(const uint8_t*, size_t) = bit_count_scalar;
+    void (*op)(BitOp, uint8_t*, const uint8_t*, size_t) = bit_op_scalar;
+    void (*max)(uint8_t*, const uint8_t*, size_t) = max_bytes_scalar;
+
+    Kernels() {
+#ifdef BITOPS_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("popcnt")) {
+            count = bit_count_popcnt;
+        }
+        if(__builtin_cpu_supports("avx2")) {
+            count = bit_count_avx2;
+            op = bit_op_avx2;
+            max = max_bytes_avx2;
+        }
+#endif
+    }
+};
+
+const Kernels& kernels() {
+    static const Kernels selected;
+    return selected;
+}
+}
+
+uint64_t bit_count(const uint8_t* data, size_t length) {
+    return kernels().count(data, length);
+}
+
+void bit_op(BitOp op, uint8_t* dst, const uint8_t* src, size_t length) {
+    kernels().op(op, dst, src, length);
+}
+
+void max_bytes(uint8_t* dst, const uint8_t* src, size_t length) {
+    kernels().max(dst, src, length);
+}
+
+int64_t bit_position(const uint8_t* data, size_t length, int bit) {
+    // Skip whole words that cannot contain the bit we are looking for
+    const uint64_t skip = bit ? 0 : ~0ULL;
+    size_t i = 0;
+    while(i + 8 <= length) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        if(word != skip) {
+            break;
+        }
+        i += 8;
+    }
+
+    for(; i < length; ++i) {
+        uint8_t byte = bit ? data[i] : static_cast<uint8_t>(~data[i]);
+        if(byte != 0) {
+            return static_cast<int64_t>(i) * 8 + __builtin_clz(byte) - 24;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,21 @@
+#ifndef BITOPS_H
+#define BITOPS_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum class BitOp { And, Or, Xor, Not };
+
+// Number of set bits in a buffer (AVX2 or POPCNT when the CPU has them)
+uint64_t bit_count(const uint8_t* data, size_t length);
+
+// dst = dst <op> src over length bytes; for Not, dst = ~src
+void bit_op(BitOp op, uint8_t* dst, const uint8_t* src, size_t length);
+
+// Byte-wise dst = max(dst, src), used to merge HyperLogLog registers
+void max_bytes(uint8_t* dst, const uint8_t* src, size_t length);
+
+// Position of the first bit equal to bit, or -1 if none (bits numbered MSB first)
+int64_t bit_position(const uint8_t* data, size_t length, int bit);
+
+#endif
@@ -0,0 +1,123 @@
+#include "ClientTracking.h"
+
+ClientTracking& ClientTracking::instance() {
+    static ClientTracking tracking;
+    return tracking;
+}
+
+void ClientTracking::enable(uint64_t client_id, std::shared_ptr<Subscriber> output, bool bcast, std::vector<std::string> prefixes) {
+    disable(client_id);
+
+    std::lock_guard<std::mutex> lock(tracking_mutex);
+    if(bcast) {
+        if(prefixes.empty()) {
+            prefixes.push_back("");
+        }
+        for(const std::string& prefix : prefixes) {
+            prefix_table[prefix].push_back(client_id);
+        }
+    }
+    clients[client_id] = TrackedClient{std::move(output), std::move(prefixes), {}};
+    tracked_clients = clients.size();
+}
+
+void ClientTracking::disable(uint64_t client_id) {
+    std::lock_guard<std::mutex> lock(tracking_mutex);
+    auto it = clients.find(client_id);
+    if(it == clients.end()) {
+        return;
+    }
+
+    for(const std::string& prefix : it->second.prefixes) {
+        auto prefix_it = prefix_table.find(prefix);
+        if(prefix_it == prefix_table.end()) {
+            continue;
+        }
+        std::erase(prefix_it->second, client_id);
+        if(prefix_it->second.empty()) {
+            prefix_table.erase(prefix_it);
+        }
+    }
+
+    for(const std::string& key : it->second.keys) {
+        auto key_it = key_table.find(key);
+        if(key_it == key_table.end()) {
+            continue;
+        }
+        std::erase(key_it->second, client_id);
+        if(key_it->second.empty()) {
+            key_table.erase(key_it);
+        }
+    }
+
+    clients.erase(it);
+    tracked_clients = clients.size();
+}
+
+void ClientTracking::remember_read(uint64_t client_id, const std::string& key) {
+    std::lock_guard<std::mutex> lock(tracking_mutex);
+    auto client_it = clients.find(client_id);
+    if(client_it == clients.end() || !client_it->second.keys.insert(key).second) {
+        return;
+    }
+
+    if(key_table.size() >= TRACKING_TABLE_MAX_KEYS && !key_table.count(key)) {
+        std::string evicted = key_table.begin()->first;
+        invalidate_locked(evicted);
+    }
+    key_table[key].push_back(client_id);
+}
+
+void ClientTracking::invalidate(const std::string& key) {
+    if(tracked_clients == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(tracking_mutex);
+    invalidate_locked(key);
+}
+
+void ClientTracking::invalidate_locked(const std::string& key) {
+    // Encoded once and shared by every client receiving it
+    std::shared_ptr<const std::string> push;
+    auto send_to = [&](TrackedClient& tracked) {
+        if(!push) {
+            push = std::make_shared<const std::string>(
+                ">2\r\n$10\r\ninvalidate\r\n*1\r\n$" + std::to_string(key.size()) + "\r\n" + key + "\r\n");
+        }
+        tracked.output->enqueue(push);
+    };
+
+    // Default-mode entries are one-shot: the client has to read the key again to be notified again
+    auto node = key_table.extract(key);
+    if(!node.empty()) {
+        for(uint64_t client_id : node.mapped()) {
+            TrackedClient& tracked = clients.at(client_id);
+            tracked.keys.erase(node.key());
+            send_to(tracked);
+        }
+    }
+
+    for(const auto& [prefix, ids] : prefix_table) {
+        if(key.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        for(uint64_t client_id : ids) {
+            send_to(clients.at(client_id));
+        }
+    }
+}
+
+void ClientTracking::invalidate_all() {
+    if(tracked_clients == 0) {
+        return;
+    }
+
+    auto push = std::make_shared<const std::string>(">2\r\n$10\r\ninvalidate\r\n_\r\n");
+    std::lock_guard<std::mutex> lock(tracking_mutex);
+    key_table.clear();
+    for(auto& [client_id, tracked] : clients) {
+        tracked.keys.clear();
+        tracked.output->enqueue(push);
+    }
+}
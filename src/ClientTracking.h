@@ -0,0 +1,55 @@
+#ifndef CLIENTTRACKING_H
+#define CLIENTTRACKING_H
+
+#include "PubSub.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Past this many remembered keys an arbitrary one is invalidated to make room, as Redis does
+constexpr std::size_t TRACKING_TABLE_MAX_KEYS = 1 << 20;
+
+class ClientTracking {
+private:
+    struct TrackedClient {
+        std::shared_ptr<Subscriber> output;  // Queue the invalidation pushes are written through
+        std::vector<std::string> prefixes;   // BCAST prefixes; empty means every key
+        std::unordered_set<std::string> keys;  // key_table entries naming this client
+    };
+
+    std::unordered_map<uint64_t, TrackedClient> clients;
+    std::unordered_map<std::string, std::vector<uint64_t>> key_table;     // Key -> clients that read it
+    std::unordered_map<std::string, std::vector<uint64_t>> prefix_table;  // BCAST prefix -> clients
+    std::mutex tracking_mutex;
+    std::atomic<size_t> tracked_clients{0};  // Lets writes skip the lock when nobody tracks
+
+    // Push an invalidation for a key to every client tracking it. Needs tracking_mutex
+    void invalidate_locked(const std::string& key);
+
+public:
+    // Process-wide invalidation table
+    static ClientTracking& instance();
+
+    // Turn tracking on for a client, replacing any previous mode
+    void enable(uint64_t client_id, std::shared_ptr<Subscriber> output, bool bcast, std::vector<std::string> prefixes);
+
+    // Turn tracking off and forget the client
+    void disable(uint64_t client_id);
+
+    // Record that a client in default mode has read (and may cache) a key. When the table is
+    // full another key is invalidated first, so its readers drop it from their caches
+    void remember_read(uint64_t client_id, const std::string& key);
+
+    // Notify every client caching this key; default-mode entries are one-shot
+    void invalidate(const std::string& key);
+
+    // Notify every tracking client that all keys are gone (FLUSHALL)
+    void invalidate_all();
+};
+
+#endif
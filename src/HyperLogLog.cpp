@@ -0,0 +1,225 @@
+#include "HyperLogLog.h"
+#include "BitOps.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace HyperLogLog {
+
+namespace {
+
+constexpr uint8_t ENCODING_DENSE = 0;
+constexpr uint8_t ENCODING_SPARSE = 1;
+constexpr int HLL_Q = 64 - HLL_P;  // Hash bits left after the register index
+constexpr size_t SPARSE_ENTRY_SIZE = 3;
+
+uint64_t murmur_hash64a(const void* key, size_t length, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (length * m);
+    const uint8_t* data = static_cast<const uint8_t*>(key);
+    const uint8_t* end = data + (length - length % 8);
+
+    for(; data != end; data += 8) {
+        uint64_t k;
+        std::memcpy(&k, data, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    switch(length & 7) {
+    case 7: h ^= static_cast<uint64_t>(data[6]) << 48; [[fallthrough]];
+    case 6: h ^= static_cast<uint64_t>(data[5]) << 40; [[fallthrough]];
+    case 5: h ^= static_cast<uint64_t>(data[4]) << 32; [[fallthrough]];
+    case 4: h ^= static_cast<uint64_t>(data[3]) << 24; [[fallthrough]];
+    case 3: h ^= static_cast<uint64_t>(data[2]) << 16; [[fallthrough]];
+    case 2: h ^= static_cast<uint64_t>(data[1]) << 8; [[fallthrough]];
+    case 1: h ^= static_cast<uint64_t>(data[0]); h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+uint8_t encoding(const std::string& sketch) {
+    return static_cast<uint8_t>(sketch[4]);
+}
+
+uint16_t sparse_index(const std::string& sketch, size_t offset) {
+    return static_cast<uint16_t>(static_cast<uint8_t>(sketch[offset]) |
+                                 (static_cast<uint8_t>(sketch[offset + 1]) << 8));
+}
+
+// Tail of the improved raw estimator (Ertl, "New cardinality estimation algorithms for HyperLogLog sketches")
+double tau(double x) {
+    if(x == 0.0 || x == 1.0) {
+        return 0.0;
+    }
+    double z_prime;
+    double y = 1.0;
+    double z = 1 - x;
+    do {
+        x = std::sqrt(x);
+        z_prime = z;
+        y *= 0.5;
+        z -= std::pow(1 - x, 2) * y;
+    } while(z_prime != z);
+    return z / 3;
+}
+
+double sigma(double x) {
+    if(x == 1.0) {
+        return INFINITY;
+    }
+    double z_prime;
+    double y = 1;
+    double z = x;
+    do {
+        x *= x;
+        z_prime = z;
+        z += x * y;
+        y += y;
+    } while(z_prime != z);
+    return z;
+}
+
+}
+
+std::string create() {
+    std::string sketch("HYLL\0\0\0\0", HLL_HEADER_SIZE);
+    sketch[4] = static_cast<char>(ENCODING_SPARSE);
+    return sketch;
+}
+
+bool is_valid(const std::string& value) {
+    if(value.size() < HLL_HEADER_SIZE || value.compare(0, 4, "HYLL") != 0) {
+        return false;
+    }
+
+    // Registers are used as histogram indices and sparse entries are binary searched, so any
+    // user-supplied sketch has to be checked register by register before it is read
+    if(encoding(value) == ENCODING_DENSE) {
+        if(value.size() != HLL_HEADER_SIZE + HLL_REGISTERS) {
+            return false;
+        }
+        uint8_t highest = 0;
+        for(size_t offset = HLL_HEADER_SIZE; offset < value.size(); ++offset) {
+            highest = std::max(highest, static_cast<uint8_t>(value[offset]));
+        }
+        return highest <= HLL_Q + 1;
+    }
+
+    size_t payload = value.size() - HLL_HEADER_SIZE;
+    if(encoding(value) != ENCODING_SPARSE || payload % SPARSE_ENTRY_SIZE != 0 || payload > HLL_SPARSE_MAX_BYTES) {
+        return false;
+    }
+    int previous = -1;
+    for(size_t offset = HLL_HEADER_SIZE; offset < value.size(); offset += SPARSE_ENTRY_SIZE) {
+        int index = sparse_index(value, offset);
+        uint8_t run = static_cast<uint8_t>(value[offset + 2]);
+        if(index >= HLL_REGISTERS || index <= previous || run == 0 || run > HLL_Q + 1) {
+            return false;
+        }
+        previous = index;
+    }
+    return true;
+}
+
+bool add(std::string& sketch, const std::string& element) {
+    uint64_t hash = murmur_hash64a(element.data(), element.size(), 0xadc83b19ULL);
+    uint16_t index = static_cast<uint16_t>(hash & (HLL_REGISTERS - 1));
+    hash >>= HLL_P;
+    hash |= 1ULL << HLL_Q;  // Caps the run length at HLL_Q + 1
+    uint8_t run = static_cast<uint8_t>(__builtin_ctzll(hash) + 1);
+
+    if(encoding(sketch) == ENCODING_DENSE) {
+        char& reg = sketch[HLL_HEADER_SIZE + index];
+        if(static_cast<uint8_t>(reg) >= run) {
+            return false;
+        }
+        reg = static_cast<char>(run);
+        return true;
+    }
+
+    // Binary search the sorted sparse entries for the register
+    size_t low = 0;
+    size_t high = (sketch.size() - HLL_HEADER_SIZE) / SPARSE_ENTRY_SIZE;
+    while(low < high) {
+        size_t mid = (low + high) / 2;
+        if(sparse_index(sketch, HLL_HEADER_SIZE + mid * SPARSE_ENTRY_SIZE) < index) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    size_t offset = HLL_HEADER_SIZE + low * SPARSE_ENTRY_SIZE;
+    if(offset < sketch.size() && sparse_index(sketch, offset) == index) {
+        if(static_cast<uint8_t>(sketch[offset + 2]) >= run) {
+            return false;
+        }
+        sketch[offset + 2] = static_cast<char>(run);
+        return true;
+    }
+
+    if(sketch.size() - HLL_HEADER_SIZE + SPARSE_ENTRY_SIZE > HLL_SPARSE_MAX_BYTES) {
+        // Sparse form no longer pays off: promote, then retry on the dense registers
+        std::vector<uint8_t> registers(HLL_REGISTERS, 0);
+        merge_into(registers.data(), sketch);
+        store_dense(sketch, registers.data());
+        return add(sketch, element);
+    }
+
+    const char entry[SPARSE_ENTRY_SIZE] = {static_cast<char>(index & 0xff), static_cast<char>(index >> 8),
+                                           static_cast<char>(run)};
+    sketch.insert(offset, entry, SPARSE_ENTRY_SIZE);
+    return true;
+}
+
+void merge_into(uint8_t* registers, const std::string& sketch) {
+    if(encoding(sketch) == ENCODING_DENSE) {
+        max_bytes(registers, reinterpret_cast<const uint8_t*>(sketch.data()) + HLL_HEADER_SIZE, HLL_REGISTERS);
+        return;
+    }
+
+    for(size_t offset = HLL_HEADER_SIZE; offset + SPARSE_ENTRY_SIZE <= sketch.size(); offset += SPARSE_ENTRY_SIZE) {
+        uint16_t index = sparse_index(sketch, offset);
+        uint8_t value = static_cast<uint8_t>(sketch[offset + 2]);
+        if(index < HLL_REGISTERS && value > registers[index]) {
+            registers[index] = value;
+        }
+    }
+}
+
+uint64_t count(const uint8_t* registers) {
+    int histogram[HLL_Q + 2] = {0};
+    for(int i = 0; i < HLL_REGISTERS; ++i) {
+        // Clamped so a register that slipped past is_valid() cannot index out of bounds
+        ++histogram[std::min<int>(registers[i], HLL_Q + 1)];
+    }
+
+    const double m = HLL_REGISTERS;
+    double z = m * tau((m - histogram[HLL_Q + 1]) / m);
+    for(int k = HLL_Q; k >= 1; --k) {
+        z += histogram[k];
+        z *= 0.5;
+    }
+    z += m * sigma(histogram[0] / m);
+    return static_cast<uint64_t>(std::llround(0.5 / std::log(2.0) * m * m / z));
+}
+
+void store_dense(std::string& sketch, const uint8_t* registers) {
+    sketch.assign(create());
+    sketch.resize(HLL_HEADER_SIZE + HLL_REGISTERS);
+    sketch[4] = static_cast<char>(ENCODING_DENSE);
+    std::memcpy(sketch.data() + HLL_HEADER_SIZE, registers, HLL_REGISTERS);
+}
+
+}
@@ -0,0 +1,41 @@
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+
+#include <cstdint>
+#include <string>
+
+// HyperLogLog sketches stored as plain string values in KeyValueStore.
+//
+// Layout: "HYLL", one encoding byte, three reserved bytes, then either
+//   dense:  HLL_REGISTERS bytes, one register per byte
+//   sparse: sorted 3-byte entries (register index, little-endian u16; value u8)
+// Sketches start sparse and become dense once the sparse form stops being smaller.
+namespace HyperLogLog {
+
+constexpr int HLL_P = 14;
+constexpr int HLL_REGISTERS = 1 << HLL_P;
+constexpr size_t HLL_HEADER_SIZE = 8;
+constexpr size_t HLL_SPARSE_MAX_BYTES = 3000;
+
+// An empty sparse sketch
+std::string create();
+
+// True if the string holds a well-formed sketch in either encoding: register values a 64-bit
+// hash can produce and, when sparse, in-range register indices in strictly ascending order
+bool is_valid(const std::string& value);
+
+// Add an element; returns true if any register changed
+bool add(std::string& sketch, const std::string& element);
+
+// Fold a sketch's registers into a dense register array of HLL_REGISTERS bytes
+void merge_into(uint8_t* registers, const std::string& sketch);
+
+// Estimated cardinality of a dense register array
+uint64_t count(const uint8_t* registers);
+
+// Replace a sketch with the dense encoding of the given registers
+void store_dense(std::string& sketch, const uint8_t* registers);
+
+}
+
+#endif
@@ -1,16 +1,75 @@
 #include "KeyValueStore.h"
+#include "LazyFree.h"
+#include "ClientTracking.h"
+#include "Lzf.h"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
 #include <thread>
 #include <chrono>
 
+// Expand an LZF-compressed value. Throws if the stored bytes do not expand to the recorded size
+static std::string decompress_value(const std::string& compressed, size_t uncompressed_size) {
+    std::string value(uncompressed_size, '\0');
+    size_t length = lzf_decompress(reinterpret_cast<const uint8_t*>(compressed.data()), compressed.size(),
+                                   reinterpret_cast<uint8_t*>(value.data()), value.size());
+    if(length != uncompressed_size) {
+        throw std::runtime_error("corrupt compressed value");
+    }
+    return value;
+}
+
 void KeyValueStore::set(const std::string& key, const std::string& value, int expiry_time, bool is_milliseconds) {
+    // Copy (and compress, if enabled) before taking the lock
+    std::string stored_value;
+    size_t uncompressed_size = 0;
+    if(compression_enabled && !value.empty() && value.size() >= compression_threshold) {
+        // Only keep the compressed form if it is actually smaller
+        stored_value.resize(value.size() - 1);
+        size_t compressed_size = lzf_compress(reinterpret_cast<const uint8_t*>(value.data()), value.size(),
+                                              reinterpret_cast<uint8_t*>(stored_value.data()), stored_value.size());
+        if(compressed_size > 0) {
+            stored_value.resize(compressed_size);
+            stored_value.shrink_to_fit();
+            uncompressed_size = value.size();
+        }
+    }
+    if(uncompressed_size == 0) {
+        stored_value = value;
+    }
+
+    int64_t expires_at_ms = 0;
+    if(expiry_time > 0) {
+        int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        expires_at_ms = now_ms + (is_milliseconds ? expiry_time : expiry_time * 1000LL);
+    }
+
+    std::string old_value;
+    uint64_t expiry_token = 0;
     {
-        std::lock_guard<std::mutex> lock(map_mutex);
-        data[key] = value;
+        std::lock_guard<std::recursive_mutex> lock(map_mutex);
+        Entry& slot = data[key];
+        account_locked(slot, false);
+        old_value.swap(slot.value);
+        slot.value.swap(stored_value);
+        slot.uncompressed_size = uncompressed_size;
+        slot.version = ++next_version;
+        slot.expiry_token = slot.version;
+        slot.expires_at_ms = expires_at_ms;
+        expiry_token = slot.version;
+        account_locked(slot, true);
+        ClientTracking::instance().invalidate(key);
+    }
+
+    // Release the overwritten value outside of the lock
+    if(old_value.size() >= LAZYFREE_THRESHOLD_BYTES) {
+        LazyFree::instance().release(std::move(old_value));
     }
 
     // If expiry is set, start a timer thread to remove the key
     if(expiry_time > 0) {
-        std::thread([this, key, expiry_time, is_milliseconds]() {
+        std::thread([this, key, expiry_time, is_milliseconds, expiry_token]() {
             if(is_milliseconds)
             {
                 std::this_thread::sleep_for(std::chrono::milliseconds(expiry_time));
@@ -18,19 +77,300 @@ void KeyValueStore::set(const std::string& key, const std::string& value, int ex
             else {
                 std::this_thread::sleep_for(std::chrono::seconds(expiry_time));
             }
-            std::lock_guard<std::mutex> lock(map_mutex);
-            data.erase(key);
+            // A later SET of the same key replaces the token, so this timer no longer applies
+            std::lock_guard<std::recursive_mutex> lock(map_mutex);
+            auto it = data.find(key);
+            if(it != data.end() && it->second.expiry_token == expiry_token) {
+                erase_locked(key, true);
+            }
         }).detach();
     }
 }
 
 std::string KeyValueStore::get(const std::string& key) {
-    std::lock_guard<std::mutex> lock(map_mutex);
-    auto it = data.find(key);
-    return (it != data.end()) ? it->second : "";
+    std::string stored_value;
+    size_t uncompressed_size = 0;
+    {
+        std::lock_guard<std::recursive_mutex> lock(map_mutex);
+        auto it = data.find(key);
+        if(it == data.end()) {
+            return "";
+        }
+        stored_value = it->second.value;
+        uncompressed_size = it->second.uncompressed_size;
+    }
+
+    if(uncompressed_size == 0) {
+        return stored_value;
+    }
+
+    // Decompress outside the lock; only the smaller compressed copy was made under it
+    return decompress_value(stored_value, uncompressed_size);
 }
 
 bool KeyValueStore::exists(const std::string& key) {
-    std::lock_guard<std::mutex> lock(map_mutex);
+    std::lock_guard<std::recursive_mutex> lock(map_mutex);
     return data.find(key) != data.end();
-}
\ No newline at end of file
+}
+
+bool KeyValueStore::del(const std::string& key) {
+    std::lock_guard<std::recursive_mutex> lock(map_mutex);
+    return erase_locked(key, false);
+}
+
+bool KeyValueStore::unlink(const std::string& key) {
+    std::lock_guard<std::recursive_mutex> lock(map_mutex);
+    return erase_locked(key, true);
+}
+
+void KeyValueStore::flush(bool async) {
+    std::unordered_map<std::string, Entry> old_data;
+    {
+        std::lock_guard<std::recursive_mutex> lock(map_mutex);
+        old_data.swap(data);
+        for(const auto& [key, watchers] : watch_counts) {
+            if(old_data.count(key)) {
+                tombstones[key] = ++next_version;
+            }
+        }
+        compression_totals.values = 0;
+        compression_totals.original_bytes = 0;
+        compression_totals.stored_bytes = 0;
+        ClientTracking::instance().invalidate_all();
+    }
+
+    if(async) {
+        LazyFree::instance().release(std::move(old_data));
+    }
+}
+
+bool KeyValueStore::erase_locked(const std::string& key, bool lazy) {
+    auto node = data.extract(key);
+    if(node.empty()) {
+        return false;
+    }
+    account_locked(node.mapped(), false);
+    if(watch_counts.count(key)) {
+        tombstones[key] = ++next_version;
+    }
+    ClientTracking::instance().invalidate(key);
+
+    // Only the node handle leaves the map here; the value buffer is freed on the background thread
+    if(lazy && node.mapped().value.size() >= LAZYFREE_THRESHOLD_BYTES) {
+        LazyFree::instance().release(std::move(node.mapped().value));
+    }
+    return true;
+}
+
+void KeyValueStore::read(const std::string& key, const std::function<void(const std::string* value)>& fn) {
+    std::unique_lock<std::recursive_mutex> lock(map_mutex);
+    auto it = data.find(key);
+    if(it == data.end()) {
+        fn(nullptr);
+        return;
+    }
+    if(it->second.uncompressed_size == 0) {
+        fn(&it->second.value);
+        return;
+    }
+
+    // Only the smaller compressed copy is made under the lock; callers already holding lock()
+    // keep it, so for them decompression still happens under the store lock
+    std::string compressed = it->second.value;
+    size_t uncompressed_size = it->second.uncompressed_size;
+    lock.unlock();
+    std::string value = decompress_value(compressed, uncompressed_size);
+    fn(&value);
+}
+
+bool KeyValueStore::modify(const std::string& key, const std::function<bool(std::string& value)>& fn) {
+    std::lock_guard<std::recursive_mutex> lock(map_mutex);
+    auto [it, created] = data.try_emplace(key);
+    // Values edited in place (bitmaps, HyperLogLogs) are kept uncompressed from here on
+    decompress_locked(it->second);
+    if(!fn(it->second.value) && !created) {
+        return false;
+    }
+    it->second.version = ++next_version;
+    ClientTracking::instance().invalidate(key);
+    return true;
+}
+
+void KeyValueStore::persist(const std::string& key) {
+    std::lock_guard<std::recursive_mutex> lock(map_mutex);
+    auto it = data.find(key);
+    if(it != data.end()) {
+        // Versions start at 1, so no timer carries this token
+        it->second.expiry_token = 0;
+        it->second.expires_at_ms = 0;
+    }
+}
+
+uint64_t KeyValueStore::version(const std::string& key) {
+    std::lock_guard<std::recursive_mutex> lock(map_mutex);
+    auto it = data.find(key);
+    if(it != data.end()) {
+        return it->second.version;
+    }
+    auto tombstone = tombstones.find(key);
+    return (tombstone != tombstones.end()) ? tombstone->second : 0;
+}
+
+uint64_t KeyValueStore::watch(const std::string& key) {
+    std::lock_guard<std::recursive_mutex> lock(map_mutex);
+    ++watch_counts[key];
+    return version(key);
+}
+
+void KeyValueStore::unwatch(const std::string& key) {
+    std::lock_guard<std::recursive_mutex> lock(map_mutex);
+    auto it = watch_counts.find(key);
+    if(it == watch_counts.end()) {
+        return;
+    }
+    if(--it->second == 0) {
+        watch_counts.erase(it);
+        tombstones.erase(key);
+    }
+}
+
+std::unique_lock<std::recursive_mutex> KeyValueStore::lock() {
+    return std::unique_lock<std::recursive_mutex>(map_mutex);
+}
+
+void KeyValueStore::set_compression(bool enabled, size_t threshold) {
+    compression_threshold = threshold;
+    compression_enabled = enabled;
+}
+
+CompressionStats KeyValueStore::compression_stats() {
+    std::lock_guard<std::recursive_mutex> lock(map_mutex);
+    CompressionStats stats = compression_totals;
+    stats.enabled = compression_enabled;
+    stats.threshold = compression_threshold;
+    return stats;
+}
+
+// RDB length encoding: 6-bit, 14-bit, 32-bit or 64-bit big-endian
+static void append_rdb_length(std::string& out, uint64_t length) {
+    if(length < (1 << 6)) {
+        out.push_back(static_cast<char>(length));
+    }
+    else if(length < (1 << 14)) {
+        out.push_back(static_cast<char>(0x40 | (length >> 8)));
+        out.push_back(static_cast<char>(length & 0xff));
+    }
+    else {
+        int bytes = length <= 0xffffffffULL ? 4 : 8;
+        out.push_back(static_cast<char>(bytes == 4 ? 0x80 : 0x81));
+        for(int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<char>((length >> shift) & 0xff));
+        }
+    }
+}
+
+void KeyValueStore::append_rdb_value_locked(const Entry& entry, std::string& out) {
+    if(entry.uncompressed_size > 0) {
+        out.push_back(static_cast<char>(0xC3));  // RDB_ENC_LZF
+        append_rdb_length(out, entry.value.size());
+        append_rdb_length(out, entry.uncompressed_size);
+    }
+    else {
+        append_rdb_length(out, entry.value.size());
+    }
+    out += entry.value;
+}
+
+bool KeyValueStore::dump_rdb_string(const std::string& key, std::string& out) {
+    std::lock_guard<std::recursive_mutex> lock(map_mutex);
+    auto it = data.find(key);
+    if(it == data.end()) {
+        return false;
+    }
+    append_rdb_value_locked(it->second, out);
+    return true;
+}
+
+bool KeyValueStore::save_rdb(const std::string& path) {
+    std::string temp_path = path + ".tmp";
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if(!file) {
+        return false;
+    }
+
+    // Entries are encoded into a buffer that is written out whenever it grows past a megabyte
+    std::string buffer = "REDIS0011";
+    buffer += "\xFA";  // Auxiliary field
+    append_rdb_length(buffer, 9);
+    buffer += "redis-ver";
+    append_rdb_length(buffer, 5);
+    buffer += "7.2.0";
+    {
+        std::lock_guard<std::recursive_mutex> lock(map_mutex);
+        size_t expiring = 0;
+        for(const auto& [key, entry] : data) {
+            expiring += entry.expires_at_ms != 0;
+        }
+        buffer += "\xFE";  // SELECTDB 0
+        append_rdb_length(buffer, 0);
+        buffer += "\xFB";  // RESIZEDB
+        append_rdb_length(buffer, data.size());
+        append_rdb_length(buffer, expiring);
+
+        for(const auto& [key, entry] : data) {
+            if(entry.expires_at_ms != 0) {
+                buffer += "\xFC";  // Expiry in milliseconds, little-endian
+                for(int shift = 0; shift < 64; shift += 8) {
+                    buffer.push_back(static_cast<char>((static_cast<uint64_t>(entry.expires_at_ms) >> shift) & 0xff));
+                }
+            }
+            buffer.push_back('\0');  // String value
+            append_rdb_length(buffer, key.size());
+            buffer += key;
+            append_rdb_value_locked(entry, buffer);
+
+            if(buffer.size() >= (1 << 20)) {
+                file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                buffer.clear();
+            }
+        }
+    }
+
+    // EOF, then an all-zero checksum, which tells loaders that checksumming is disabled
+    buffer += "\xFF";
+    buffer.append(8, '\0');
+    file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    file.close();
+    if(!file) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+void KeyValueStore::account_locked(const Entry& entry, bool add) {
+    if(entry.uncompressed_size == 0) {
+        return;
+    }
+    if(add) {
+        ++compression_totals.values;
+        compression_totals.original_bytes += entry.uncompressed_size;
+        compression_totals.stored_bytes += entry.value.size();
+    }
+    else {
+        --compression_totals.values;
+        compression_totals.original_bytes -= entry.uncompressed_size;
+        compression_totals.stored_bytes -= entry.value.size();
+    }
+}
+
+void KeyValueStore::decompress_locked(Entry& entry) {
+    if(entry.uncompressed_size == 0) {
+        return;
+    }
+    // Expanded before the totals are touched, so a corrupt entry is left as it was
+    std::string value = decompress_value(entry.value, entry.uncompressed_size);
+    account_locked(entry, false);
+    entry.value.swap(value);
+    entry.uncompressed_size = 0;
+}
@@ -1,24 +1,116 @@
 #ifndef KEYVALUESTORE_H
 #define KEYVALUESTORE_H
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <mutex>
 
+// Totals reported by INFO for transparently compressed values
+struct CompressionStats {
+    bool enabled = false;
+    size_t threshold = 0;
+    size_t values = 0;          // Values currently stored compressed
+    size_t original_bytes = 0;  // Their size before compression
+    size_t stored_bytes = 0;    // Their size in memory
+};
+
+// Reading a compressed value (get, read, modify) throws std::runtime_error if the stored
+// bytes turn out to be corrupt, rather than returning a wrong value
 class KeyValueStore {
 private:
-    std::unordered_map<std::string, std::string> data;
-    std::mutex map_mutex;
+    struct Entry {
+        std::string value;
+        uint64_t version = 0;  // Changes on every write, used by WATCH
+        size_t uncompressed_size = 0;  // Non-zero when value holds LZF-compressed bytes
+        uint64_t expiry_token = 0;     // Version of the SET whose expiry timer may remove this entry
+        int64_t expires_at_ms = 0;     // Unix time in milliseconds of that expiry, 0 if none
+    };
+
+    std::unordered_map<std::string, Entry> data;
+    std::recursive_mutex map_mutex;  // Recursive so EXEC can hold it across queued commands
+    uint64_t next_version = 0;
+
+    // Deleting a watched key records a fresh version here, so WATCH still sees the change
+    std::unordered_map<std::string, size_t> watch_counts;  // Key -> number of clients watching it
+    std::unordered_map<std::string, uint64_t> tombstones;  // Watched key -> version of its deletion
+
+    std::atomic<bool> compression_enabled{false};
+    std::atomic<size_t> compression_threshold{4096};
+    CompressionStats compression_totals;  // Guarded by map_mutex
+
+    // Add or remove a compressed entry from compression_totals. Caller holds map_mutex.
+    void account_locked(const Entry& entry, bool add);
+
+    // Expand a compressed entry in place so it can be read or modified directly. Caller holds map_mutex.
+    void decompress_locked(Entry& entry);
+
+    // Append an entry's value as an RDB string. Caller holds map_mutex.
+    void append_rdb_value_locked(const Entry& entry, std::string& out);
+
+    // Remove a key, handing large values to the lazy-free thread. Caller holds map_mutex.
+    bool erase_locked(const std::string& key, bool lazy);
 
 public:
-    // Set a key with optional expiry in milliseconds
-    void set(const std::string& key, const std::string& value, int expiry_time_in_milliseconds = -1);
+    // Set a key with optional expiry (milliseconds by default, seconds otherwise)
+    void set(const std::string& key, const std::string& value, int expiry_time = -1, bool is_milliseconds = true);
 
     // Get a value by key
     std::string get(const std::string& key);
 
     // Check if a key exists
     bool exists(const std::string& key);
+
+    // Delete a key, freeing its value inline. Returns true if the key existed
+    bool del(const std::string& key);
+
+    // Delete a key, freeing large values in the background. Returns true if the key existed
+    bool unlink(const std::string& key);
+
+    // Remove every key; with async the old contents are freed in the background
+    void flush(bool async);
+
+    // Inspect a value under the store lock; value is nullptr if the key is missing. A compressed
+    // value is expanded into a copy and fn runs on it after the lock is released (unless the
+    // caller holds lock())
+    void read(const std::string& key, const std::function<void(const std::string* value)>& fn);
+
+    // Modify a value in place under the store lock, creating it empty if missing.
+    // fn returns whether it changed the value; returns false if nothing was written
+    bool modify(const std::string& key, const std::function<bool(std::string& value)>& fn);
+
+    // Cancel a pending expiry so the key lives until it is deleted (PERSIST)
+    void persist(const std::string& key);
+
+    // Current write version of a key. A deleted watched key reports the version of its
+    // deletion; any other missing key reports 0
+    uint64_t version(const std::string& key);
+
+    // Start watching a key and return its current version
+    uint64_t watch(const std::string& key);
+
+    // Stop watching a key; its tombstone is dropped once nobody watches it
+    void unwatch(const std::string& key);
+
+    // Hold the store lock across several operations (used by EXEC)
+    std::unique_lock<std::recursive_mutex> lock();
+
+    // Store values of at least threshold bytes LZF-compressed (off by default)
+    void set_compression(bool enabled, size_t threshold);
+
+    // Current compression settings and totals
+    CompressionStats compression_stats();
+
+    // Append a key's value in RDB string encoding. Compressed values are emitted as
+    // RDB LZF strings straight from memory, without recompressing. Returns false if the key is missing
+    bool dump_rdb_string(const std::string& key, std::string& out);
+
+    // Write every key to an RDB snapshot at path, via a temporary file renamed into place.
+    // Holds the store lock throughout, like Redis' SAVE. Returns false if writing fails
+    bool save_rdb(const std::string& path);
 };
 
-#endif
\ No newline at end of file
+#endif
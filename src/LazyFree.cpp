@@ -0,0 +1,42 @@
+#include "LazyFree.h"
+
+LazyFree::LazyFree() : worker(&LazyFree::run, this) {}
+
+LazyFree::~LazyFree() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_one();
+    worker.join();
+}
+
+LazyFree& LazyFree::instance() {
+    static LazyFree lazy_free;
+    return lazy_free;
+}
+
+void LazyFree::enqueue(std::shared_ptr<void> object) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        pending.push_back(std::move(object));
+    }
+    queue_cv.notify_one();
+}
+
+void LazyFree::run() {
+    while(true) {
+        std::deque<std::shared_ptr<void>> batch;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this]() { return stopping || !pending.empty(); });
+            if(pending.empty() && stopping) {
+                return;
+            }
+            batch.swap(pending);
+        }
+
+        // Objects are destroyed here, outside of every lock
+        batch.clear();
+    }
+}
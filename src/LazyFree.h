@@ -0,0 +1,47 @@
+#ifndef LAZYFREE_H
+#define LAZYFREE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Values at least this large are reclaimed by the background thread
+// instead of inline while the store lock is held.
+constexpr std::size_t LAZYFREE_THRESHOLD_BYTES = 64 * 1024;
+
+class LazyFree {
+private:
+    std::deque<std::shared_ptr<void>> pending;  // Objects waiting to be destroyed
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    bool stopping = false;
+    std::thread worker;
+
+    LazyFree();
+
+    // Background loop that destroys queued objects
+    void run();
+
+public:
+    ~LazyFree();
+
+    LazyFree(const LazyFree&) = delete;
+    LazyFree& operator=(const LazyFree&) = delete;
+
+    // Process-wide reclamation thread
+    static LazyFree& instance();
+
+    // Hand an object to the background thread; it is destroyed there
+    template <typename T>
+    void release(T&& object) {
+        enqueue(std::make_shared<std::decay_t<T>>(std::forward<T>(object)));
+    }
+
+    // Queue an already type-erased object for destruction
+    void enqueue(std::shared_ptr<void> object);
+};
+
+#endif
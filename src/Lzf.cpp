@@ -0,0 +1,161 @@
+#include "Lzf.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr int HASH_LOG = 14;
+constexpr size_t MAX_LITERAL = 32;
+constexpr size_t MAX_OFFSET = 1 << 13;
+constexpr size_t MAX_MATCH = 7 + 255 + 2;
+
+inline uint32_t hash3(const uint8_t* p) {
+    uint32_t v = (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+    return (v * 2654435761u) >> (32 - HASH_LOG);
+}
+
+}
+
+size_t lzf_compress(const uint8_t* in, size_t in_length, uint8_t* out, size_t out_length) {
+    if(in_length == 0 || out_length == 0) {
+        return 0;
+    }
+
+    // Last position seen for each 3-byte hash. Not cleared between calls: entries
+    // left over from earlier inputs fall outside [in, ip) and are ignored below
+    thread_local const uint8_t* table[1 << HASH_LOG];
+
+    const uint8_t* ip = in;
+    const uint8_t* in_end = in + in_length;
+    uint8_t* op = out + 1;  // Room for the first literal run's control byte
+    uint8_t* out_end = out + out_length;
+    size_t literals = 0;
+
+    while(ip + 2 < in_end) {
+        uint32_t h = hash3(ip);
+        const uint8_t* ref = table[h];
+        table[h] = ip;
+
+        uintptr_t distance = reinterpret_cast<uintptr_t>(ip) - reinterpret_cast<uintptr_t>(ref);
+        if(reinterpret_cast<uintptr_t>(ref) >= reinterpret_cast<uintptr_t>(in) && distance > 0 && distance <= MAX_OFFSET &&
+           ref[0] == ip[0] && ref[1] == ip[1] && ref[2] == ip[2]) {
+            size_t offset = distance - 1;
+            size_t max_length = std::min(static_cast<size_t>(in_end - ip), MAX_MATCH);
+            size_t length = 3;
+            while(length < max_length && ref[length] == ip[length]) {
+                ++length;
+            }
+
+            // Back reference plus the next run's control byte
+            if(op + 4 > out_end) {
+                return 0;
+            }
+
+            // Close the pending literal run, or reclaim its unused control byte
+            if(literals > 0) {
+                op[-static_cast<ptrdiff_t>(literals) - 1] = static_cast<uint8_t>(literals - 1);
+            }
+            else {
+                --op;
+            }
+
+            size_t encoded = length - 2;
+            if(encoded < 7) {
+                *op++ = static_cast<uint8_t>((offset >> 8) + (encoded << 5));
+            }
+            else {
+                *op++ = static_cast<uint8_t>((offset >> 8) + (7 << 5));
+                *op++ = static_cast<uint8_t>(encoded - 7);
+            }
+            *op++ = static_cast<uint8_t>(offset & 0xff);
+
+            literals = 0;
+            ++op;
+            ip += length;
+            continue;
+        }
+
+        if(op >= out_end) {
+            return 0;
+        }
+        *op++ = *ip++;
+        if(++literals == MAX_LITERAL) {
+            op[-static_cast<ptrdiff_t>(literals) - 1] = static_cast<uint8_t>(literals - 1);
+            literals = 0;
+            if(op >= out_end) {
+                return 0;
+            }
+            ++op;
+        }
+    }
+
+    while(ip < in_end) {
+        if(op >= out_end) {
+            return 0;
+        }
+        *op++ = *ip++;
+        if(++literals == MAX_LITERAL) {
+            op[-static_cast<ptrdiff_t>(literals) - 1] = static_cast<uint8_t>(literals - 1);
+            literals = 0;
+            if(op >= out_end) {
+                return 0;
+            }
+            ++op;
+        }
+    }
+
+    if(literals > 0) {
+        op[-static_cast<ptrdiff_t>(literals) - 1] = static_cast<uint8_t>(literals - 1);
+    }
+    else {
+        --op;
+    }
+    return static_cast<size_t>(op - out);
+}
+
+size_t lzf_decompress(const uint8_t* in, size_t in_length, uint8_t* out, size_t out_length) {
+    const uint8_t* ip = in;
+    const uint8_t* in_end = in + in_length;
+    uint8_t* op = out;
+    uint8_t* out_end = out + out_length;
+
+    while(ip < in_end) {
+        size_t ctrl = *ip++;
+
+        if(ctrl < MAX_LITERAL) {
+            size_t length = ctrl + 1;
+            if(ip + length > in_end || op + length > out_end) {
+                return 0;
+            }
+            std::memcpy(op, ip, length);
+            ip += length;
+            op += length;
+            continue;
+        }
+
+        size_t length = ctrl >> 5;
+        if(length == 7) {
+            if(ip >= in_end) {
+                return 0;
+            }
+            length += *ip++;
+        }
+        if(ip >= in_end) {
+            return 0;
+        }
+        size_t offset = ((ctrl & 0x1f) << 8) + *ip++ + 1;
+        length += 2;
+        if(offset > static_cast<size_t>(op - out) || op + length > out_end) {
+            return 0;
+        }
+
+        // Byte copy: the source may overlap the bytes being written
+        const uint8_t* ref = op - offset;
+        for(size_t i = 0; i < length; ++i) {
+            op[i] = ref[i];
+        }
+        op += length;
+    }
+
+    return static_cast<size_t>(op - out);
+}
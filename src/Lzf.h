@@ -0,0 +1,15 @@
+#ifndef LZF_H
+#define LZF_H
+
+#include <cstddef>
+#include <cstdint>
+
+// LZF codec, bit-compatible with the format Redis uses for compressed RDB strings.
+
+// Compress into out; returns the compressed size, or 0 if it does not fit in out_length
+size_t lzf_compress(const uint8_t* in, size_t in_length, uint8_t* out, size_t out_length);
+
+// Decompress into out; returns the decompressed size, or 0 on corrupt input or overflow
+size_t lzf_decompress(const uint8_t* in, size_t in_length, uint8_t* out, size_t out_length);
+
+#endif
@@ -0,0 +1,390 @@
+#include "PubSub.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+static std::string bulk_string(const std::string& value) {
+    return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+}
+
+// One epoll loop writes for every Subscriber. Subscribers with queued output are handed to it
+// through the ready list; those whose socket is full wait in blocked until it is writable again.
+class OutputWriter {
+private:
+    int epoll_fd;
+    int wake_fd;  // eventfd, signalled when ready is non-empty
+    std::mutex ready_mutex;
+    std::vector<std::shared_ptr<Subscriber>> ready;
+    std::unordered_map<int, std::shared_ptr<Subscriber>> blocked;  // Only touched by the loop
+    std::atomic<bool> stopping{false};
+    std::thread loop;
+
+    OutputWriter() : epoll_fd(epoll_create1(0)), wake_fd(eventfd(0, EFD_NONBLOCK)) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = wake_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+        loop = std::thread(&OutputWriter::run, this);
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    void service(const std::shared_ptr<Subscriber>& subscriber) {
+        int fd = subscriber->client_socket;
+        auto it = blocked.find(fd);
+        if(it != blocked.end()) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+            blocked.erase(it);
+        }
+        if(subscriber->flush()) {
+            epoll_event event{};
+            event.events = EPOLLOUT;
+            event.data.fd = fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            blocked[fd] = subscriber;
+        }
+    }
+
+    void run() {
+        std::vector<epoll_event> events(256);
+        std::vector<std::shared_ptr<Subscriber>> batch;
+        while(!stopping) {
+            int count = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+            for(int i = 0; i < count; ++i) {
+                int fd = events[i].data.fd;
+                if(fd == wake_fd) {
+                    uint64_t ignored;
+                    while(read(wake_fd, &ignored, sizeof(ignored)) > 0) {
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(ready_mutex);
+                        batch.swap(ready);
+                    }
+                    for(const auto& subscriber : batch) {
+                        service(subscriber);
+                    }
+                    batch.clear();
+                    continue;
+                }
+                auto it = blocked.find(fd);
+                if(it != blocked.end()) {
+                    std::shared_ptr<Subscriber> subscriber = it->second;
+                    service(subscriber);
+                }
+            }
+        }
+    }
+
+public:
+    ~OutputWriter() {
+        stopping = true;
+        wake();
+        loop.join();
+        close(wake_fd);
+        close(epoll_fd);
+    }
+
+    static OutputWriter& instance() {
+        static OutputWriter writer;
+        return writer;
+    }
+
+    void schedule(std::shared_ptr<Subscriber> subscriber) {
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            ready.push_back(std::move(subscriber));
+        }
+        wake();
+    }
+};
+
+Subscriber::Subscriber(int client_socket) : client_socket(client_socket) {}
+
+bool Subscriber::enqueue(std::shared_ptr<const std::string> message) {
+    return queue(std::move(message), true);
+}
+
+bool Subscriber::enqueue_reply(std::shared_ptr<const std::string> message) {
+    return queue(std::move(message), false);
+}
+
+bool Subscriber::queue(std::shared_ptr<const std::string> message, bool counted) {
+    {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        if(closing || stopping) {
+            return false;
+        }
+        if(counted && counted_bytes + message->size() > PUBSUB_OUTPUT_BUFFER_LIMIT) {
+            // Slow consumer: drop its backlog and disconnect it rather than grow without bound.
+            // The shutdown also makes a blocked socket writable, so the writer lets go of it
+            std::cerr << "Subscriber output limit exceeded, closing the connection.\n";
+            closing = true;
+            drop_output();
+            shutdown(client_socket, SHUT_RDWR);
+            return false;
+        }
+        if(counted) {
+            counted_bytes += message->size();
+        }
+        output.push_back(QueuedOutput{std::move(message), counted});
+        if(scheduled) {
+            return true;
+        }
+        scheduled = true;
+    }
+    OutputWriter::instance().schedule(shared_from_this());
+    return true;
+}
+
+void Subscriber::drop_output() {
+    output.clear();
+    counted_bytes = 0;
+    front_offset = 0;
+}
+
+bool Subscriber::flush() {
+    std::unique_lock<std::mutex> lock(output_mutex);
+    while(!output.empty() && !closing) {
+        // The same buffer is written to every subscriber; nothing is copied per client
+        std::shared_ptr<const std::string> message = output.front().message;
+        size_t offset = front_offset;
+        lock.unlock();
+        ssize_t n = send(client_socket, message->data() + offset, message->size() - offset, MSG_DONTWAIT | MSG_NOSIGNAL);
+        int error = errno;
+        lock.lock();
+
+        if(n < 0 && (error == EAGAIN || error == EWOULDBLOCK)) {
+            return true;
+        }
+        if(n <= 0) {
+            closing = true;
+            drop_output();
+            break;
+        }
+        front_offset += static_cast<size_t>(n);
+        if(front_offset == message->size()) {
+            if(output.front().counted) {
+                counted_bytes -= message->size();
+            }
+            output.pop_front();
+            front_offset = 0;
+        }
+    }
+    scheduled = false;
+    idle_cv.notify_all();
+    return false;
+}
+
+void Subscriber::close() {
+    std::unique_lock<std::mutex> lock(output_mutex);
+    stopping = true;
+    if(idle_cv.wait_for(lock, std::chrono::seconds(1), [this]() { return !scheduled; })) {
+        return;
+    }
+
+    // The peer is not reading: drop the backlog and have the writer release the socket
+    closing = true;
+    drop_output();
+    lock.unlock();
+    OutputWriter::instance().schedule(shared_from_this());
+    lock.lock();
+    idle_cv.wait(lock, [this]() { return !scheduled; });
+}
+
+// Queue a frame encoded as a RESP2 array on every subscriber; RESP3 subscribers get it as a
+// push frame instead. Each variant is encoded at most once and shared. Returns the receivers
+static std::size_t deliver(const std::set<std::shared_ptr<Subscriber>>& subscribers, const std::string& frame) {
+    std::shared_ptr<const std::string> encoded[2];  // RESP2 array, RESP3 push
+    std::size_t receivers = 0;
+    for(const auto& subscriber : subscribers) {
+        int push = subscriber->protocol == 3 ? 1 : 0;
+        if(!encoded[push]) {
+            std::string variant = frame;
+            if(push) {
+                variant[0] = '>';
+            }
+            encoded[push] = std::make_shared<const std::string>(std::move(variant));
+        }
+        if(subscriber->enqueue(encoded[push])) {
+            ++receivers;
+        }
+    }
+    return receivers;
+}
+
+PubSub& PubSub::instance() {
+    static PubSub pubsub;
+    return pubsub;
+}
+
+std::size_t PubSub::subscribe(const std::shared_ptr<Subscriber>& subscriber, const std::string& channel) {
+    std::unique_lock<std::shared_mutex> lock(registry_mutex);
+    if(subscriber->channels.insert(channel).second) {
+        channels[channel].insert(subscriber);
+    }
+    return subscriber->channels.size() + subscriber->patterns.size();
+}
+
+std::size_t PubSub::unsubscribe(const std::shared_ptr<Subscriber>& subscriber, const std::string& channel) {
+    std::unique_lock<std::shared_mutex> lock(registry_mutex);
+    if(subscriber->channels.erase(channel)) {
+        auto it = channels.find(channel);
+        it->second.erase(subscriber);
+        if(it->second.empty()) {
+            channels.erase(it);
+        }
+    }
+    return subscriber->channels.size() + subscriber->patterns.size();
+}
+
+std::size_t PubSub::psubscribe(const std::shared_ptr<Subscriber>& subscriber, const std::string& pattern) {
+    std::unique_lock<std::shared_mutex> lock(registry_mutex);
+    if(subscriber->patterns.insert(pattern).second) {
+        patterns[pattern].insert(subscriber);
+    }
+    return subscriber->channels.size() + subscriber->patterns.size();
+}
+
+std::size_t PubSub::punsubscribe(const std::shared_ptr<Subscriber>& subscriber, const std::string& pattern) {
+    std::unique_lock<std::shared_mutex> lock(registry_mutex);
+    if(subscriber->patterns.erase(pattern)) {
+        auto it = patterns.find(pattern);
+        it->second.erase(subscriber);
+        if(it->second.empty()) {
+            patterns.erase(it);
+        }
+    }
+    return subscriber->channels.size() + subscriber->patterns.size();
+}
+
+void PubSub::unsubscribe_all(const std::shared_ptr<Subscriber>& subscriber) {
+    for(const std::string& channel : channels_of(subscriber)) {
+        unsubscribe(subscriber, channel);
+    }
+    for(const std::string& pattern : patterns_of(subscriber)) {
+        punsubscribe(subscriber, pattern);
+    }
+}
+
+std::set<std::string> PubSub::channels_of(const std::shared_ptr<Subscriber>& subscriber) {
+    std::shared_lock<std::shared_mutex> lock(registry_mutex);
+    return subscriber->channels;
+}
+
+std::set<std::string> PubSub::patterns_of(const std::shared_ptr<Subscriber>& subscriber) {
+    std::shared_lock<std::shared_mutex> lock(registry_mutex);
+    return subscriber->patterns;
+}
+
+std::size_t PubSub::subscription_count(const std::shared_ptr<Subscriber>& subscriber) {
+    std::shared_lock<std::shared_mutex> lock(registry_mutex);
+    return subscriber->channels.size() + subscriber->patterns.size();
+}
+
+std::size_t PubSub::publish(const std::string& channel, const std::string& message) {
+    std::size_t receivers = 0;
+    std::shared_lock<std::shared_mutex> lock(registry_mutex);
+
+    auto it = channels.find(channel);
+    if(it != channels.end()) {
+        receivers += deliver(it->second, "*3\r\n$7\r\nmessage\r\n" + bulk_string(channel) + bulk_string(message));
+    }
+
+    for(const auto& [pattern, subscribers] : patterns) {
+        if(!glob_match(pattern.c_str(), channel.c_str())) {
+            continue;
+        }
+        receivers += deliver(subscribers,
+                             "*4\r\n$8\r\npmessage\r\n" + bulk_string(pattern) + bulk_string(channel) + bulk_string(message));
+    }
+
+    return receivers;
+}
+
+bool glob_match(const char* pattern, const char* str) {
+    while(*pattern) {
+        switch(*pattern) {
+        case '*':
+            while(pattern[1] == '*') {
+                ++pattern;
+            }
+            if(pattern[1] == '\0') {
+                return true;
+            }
+            for(; *str; ++str) {
+                if(glob_match(pattern + 1, str)) {
+                    return true;
+                }
+            }
+            return false;
+        case '?':
+            if(*str == '\0') {
+                return false;
+            }
+            ++str;
+            break;
+        case '[': {
+            if(*str == '\0') {
+                return false;
+            }
+            ++pattern;
+            bool negate = *pattern == '^';
+            if(negate) {
+                ++pattern;
+            }
+            bool matched = false;
+            while(*pattern && *pattern != ']') {
+                if(*pattern == '\\' && pattern[1]) {
+                    ++pattern;
+                    matched |= *pattern == *str;
+                }
+                else if(pattern[1] == '-' && pattern[2] && pattern[2] != ']') {
+                    char low = pattern[0], high = pattern[2];
+                    if(low > high) {
+                        std::swap(low, high);
+                    }
+                    matched |= *str >= low && *str <= high;
+                    pattern += 2;
+                }
+                else {
+                    matched |= *pattern == *str;
+                }
+                ++pattern;
+            }
+            if(*pattern == '\0') {
+                --pattern;  // Unterminated class: treat the rest as consumed
+            }
+            if(matched == negate) {
+                return false;
+            }
+            ++str;
+            break;
+        }
+        case '\\':
+            if(pattern[1]) {
+                ++pattern;
+            }
+            [[fallthrough]];
+        default:
+            if(*pattern != *str) {
+                return false;
+            }
+            ++str;
+            break;
+        }
+        ++pattern;
+    }
+    return *str == '\0';
+}
@@ -0,0 +1,107 @@
+#ifndef PUBSUB_H
+#define PUBSUB_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+// A subscriber whose unsent Pub/Sub messages and pushes grow past this is disconnected.
+// Replies to its own commands are not counted
+constexpr std::size_t PUBSUB_OUTPUT_BUFFER_LIMIT = 32 * 1024 * 1024;
+
+// Asynchronous output queue of one connection. Queued replies are written by the shared
+// OutputWriter event loop, so subscribers cost no threads of their own. Once a connection
+// has one, all of its replies go through it.
+class Subscriber : public std::enable_shared_from_this<Subscriber> {
+private:
+    friend class OutputWriter;
+
+    struct QueuedOutput {
+        std::shared_ptr<const std::string> message;
+        bool counted;  // Counts towards PUBSUB_OUTPUT_BUFFER_LIMIT
+    };
+
+    int client_socket;
+    std::deque<QueuedOutput> output;  // Encoded replies and pushes waiting to be written
+    std::size_t counted_bytes = 0;    // Queued bytes of counted messages
+    std::size_t front_offset = 0;  // Bytes of output.front() already written
+    std::mutex output_mutex;
+    std::condition_variable idle_cv;  // Signalled when the writer lets go of the subscriber
+    bool scheduled = false;  // Owned by the writer loop until its queue is flushed
+    bool closing = false;    // Drop anything still queued
+    bool stopping = false;   // Accept nothing more
+
+    // Queue a message, enforcing the output limit if it is counted
+    bool queue(std::shared_ptr<const std::string> message, bool counted);
+
+    // Drop everything still queued. Caller holds output_mutex
+    void drop_output();
+
+    // Write queued output until the socket would block. Returns true if output is left.
+    // Only called from the writer loop
+    bool flush();
+
+public:
+    std::set<std::string> channels;  // Guarded by the PubSub registry lock
+    std::set<std::string> patterns;  // Guarded by the PubSub registry lock
+    std::atomic<int> protocol{2};    // RESP version; RESP3 connections get messages as push frames
+
+    explicit Subscriber(int client_socket);
+
+    Subscriber(const Subscriber&) = delete;
+    Subscriber& operator=(const Subscriber&) = delete;
+
+    // Queue a shared, already encoded Pub/Sub message or push. Returns false if the client is
+    // closing or this message took it past its output limit, which disconnects it
+    bool enqueue(std::shared_ptr<const std::string> message);
+
+    // Queue the reply to one of the client's own commands. Replies can be as large as a value
+    // and are not held against the output limit. Returns false if the client is closing
+    bool enqueue_reply(std::shared_ptr<const std::string> message);
+
+    // Stop accepting output and wait until the writer no longer uses the socket, so it can be
+    // closed. Queued replies are flushed first, for at most a second
+    void close();
+};
+
+class PubSub {
+private:
+    std::unordered_map<std::string, std::set<std::shared_ptr<Subscriber>>> channels;
+    std::unordered_map<std::string, std::set<std::shared_ptr<Subscriber>>> patterns;
+    std::shared_mutex registry_mutex;
+
+public:
+    // Process-wide channel registry
+    static PubSub& instance();
+
+    // Each call returns the subscriber's subscription count afterwards
+    std::size_t subscribe(const std::shared_ptr<Subscriber>& subscriber, const std::string& channel);
+    std::size_t unsubscribe(const std::shared_ptr<Subscriber>& subscriber, const std::string& channel);
+    std::size_t psubscribe(const std::shared_ptr<Subscriber>& subscriber, const std::string& pattern);
+    std::size_t punsubscribe(const std::shared_ptr<Subscriber>& subscriber, const std::string& pattern);
+
+    // Drop every subscription held by a disconnecting client
+    void unsubscribe_all(const std::shared_ptr<Subscriber>& subscriber);
+
+    // Snapshot of a subscriber's channels or patterns
+    std::set<std::string> channels_of(const std::shared_ptr<Subscriber>& subscriber);
+    std::set<std::string> patterns_of(const std::shared_ptr<Subscriber>& subscriber);
+
+    // Total channel and pattern subscriptions held by a subscriber
+    std::size_t subscription_count(const std::shared_ptr<Subscriber>& subscriber);
+
+    // Deliver a message, encoding it once per channel/pattern. Returns the number of receivers
+    std::size_t publish(const std::string& channel, const std::string& message);
+};
+
+// Glob-style matching used by pattern subscriptions (*, ?, [...], \)
+bool glob_match(const char* pattern, const char* str);
+
+#endif
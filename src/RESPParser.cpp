@@ -3,6 +3,9 @@
 #include <stdexcept>
 #include <sstream>
 
+// Largest bulk string accepted, matching Redis' proto-max-bulk-len default
+static constexpr long long MAX_BULK_LENGTH = 512LL * 1024 * 1024;
+
 RESPParser::RESPParser() {}
 
 void RESPParser::feed(const std::string& data) {
@@ -10,73 +13,105 @@ void RESPParser::feed(const std::string& data) {
 }
 
 void RESPParser::parse() {
-    while (!buffer.empty()) {
-        if (buffer[0] == '$') {
-            parsed_commands.push_back(parse_bulk_string());
-        } else if (buffer[0] == '*') {
-            parse_array();
-        } else {
-            std::cerr << "Error: Unknown RESP type at buffer: " << buffer << std::endl;
-            throw std::runtime_error("Unknown RESP type");
+    // Nothing is erased until a whole message has been parsed, so a message split across
+    // reads is simply parsed again from its start once the rest has arrived
+    size_t consumed = 0;
+    try {
+        while (consumed < buffer.size()) {
+            size_t pos = consumed;
+            std::vector<std::string> command;
+            bool complete;
+            if (buffer[pos] == '$') {
+                std::string value;
+                complete = parse_bulk_string(pos, value);
+                command.push_back(std::move(value));
+            } else if (buffer[pos] == '*') {
+                complete = parse_array(pos, command);
+            } else {
+                std::cerr << "Error: Unknown RESP type at buffer: " << buffer.substr(consumed, 32) << std::endl;
+                throw std::runtime_error("Unknown RESP type");
+            }
+
+            if (!complete) {
+                break;
+            }
+            parsed_commands.push_back(std::move(command));
+            consumed = pos;
         }
+    } catch (...) {
+        // The stream cannot be resynchronized after a protocol error
+        buffer.clear();
+        throw;
     }
+    buffer.erase(0, consumed);
 }
 
-std::vector<std::string> RESPParser::get_parsed_commands() {
-    std::vector<std::string> commands = parsed_commands;
-    parsed_commands.clear();
+std::vector<std::vector<std::string>> RESPParser::get_parsed_commands() {
+    std::vector<std::vector<std::string>> commands;
+    commands.swap(parsed_commands);
     return commands;
 }
 
-std::string RESPParser::parse_bulk_string() {
-    int length = parse_length("\r\n");
-    if (length == -1) return "(null)";   // Represents a null bulk string
-    if (length == 0) return "";          // Represents an empty bulk string
-    return parse_until("\r\n", length);   // Extract the bulk string data
+bool RESPParser::parse_bulk_string(size_t& pos, std::string& result) {
+    long long length;
+    if (!parse_length(pos, length)) return false;
+    if (length == -1) {
+        result = "(null)";   // Represents a null bulk string
+        return true;
+    }
+    if (length > MAX_BULK_LENGTH) {
+        throw std::runtime_error("Invalid bulk length.");
+    }
+
+    // The payload is binary safe: it is located by its length, never by searching for "\r\n"
+    size_t size = static_cast<size_t>(length);
+    if (buffer.size() - pos < size + 2) return false;
+    if (buffer.compare(pos + size, 2, "\r\n") != 0) {
+        throw std::runtime_error("Invalid data.");
+    }
+    result.assign(buffer, pos, size);
+    pos += size + 2;
+    return true;
 }
 
-void RESPParser::parse_array() {
-    int count = parse_length("\r\n");
+bool RESPParser::parse_array(size_t& pos, std::vector<std::string>& command) {
+    long long count;
+    if (!parse_length(pos, count)) return false;
 
-    for (int i = 0; i < count; ++i) {
-        if (buffer[0] == '$') {
-            parsed_commands.push_back(parse_bulk_string());
-        } else {
+    for (long long i = 0; i < count; ++i) {
+        if (pos >= buffer.size()) return false;
+        if (buffer[pos] != '$') {
             throw std::runtime_error("Unexpected format in array.");
         }
+        std::string value;
+        if (!parse_bulk_string(pos, value)) return false;
+        command.push_back(std::move(value));
     }
+    return true;
 }
 
-int RESPParser::parse_length(const std::string& delimiter) {
-    size_t end = buffer.find(delimiter);
-    
+bool RESPParser::parse_length(size_t& pos, long long& length) {
+    size_t end = buffer.find("\r\n", pos);
+
     if (end == std::string::npos) {
-        throw std::runtime_error("Incomplete data.");
+        return false;
     }
 
-    std::string lengthStr = buffer.substr(1, end - 1); // Skip '$' and read length
-    buffer.erase(0, end + delimiter.length()); // Remove the length and "\r\n" from the buffer
-
+    std::string lengthStr = buffer.substr(pos + 1, end - pos - 1); // Skip the type byte and read the length
     if (lengthStr.empty()) {
         throw std::runtime_error("Invalid length format.");
     }
 
+    size_t parsed = 0;
     try {
-        return std::stoi(lengthStr); // Convert the length to an integer
-    } catch (const std::invalid_argument& e) {
+        length = std::stoll(lengthStr, &parsed); // Convert the length to an integer
+    } catch (const std::exception& e) {
         throw std::runtime_error("Invalid length value.");
     }
-}
-
-std::string RESPParser::parse_until(const std::string& delimiter, int length) {
-    size_t end = buffer.find(delimiter);
-
-    if (end == std::string::npos) {
-        throw std::runtime_error("Invalid data.");
+    if (parsed != lengthStr.size() || length < -1) {
+        throw std::runtime_error("Invalid length value.");
     }
 
-    std::string result = buffer.substr(0, length);
-    buffer.erase(0, length + delimiter.length());
-
-    return result;
-}
\ No newline at end of file
+    pos = end + 2; // Move past the length and "\r\n"
+    return true;
+}
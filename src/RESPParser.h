@@ -1,24 +1,23 @@
 #ifndef RESPPARSER_H
 #define RESPPARSER_H
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
 class RESPParser
 {
 private:
-    std::string buffer; // Holds the incoming data
-    std::vector<std::string> parsed_commands; // Stores parsed commands
+    std::string buffer; // Holds incoming data not yet parsed into a complete message
+    std::vector<std::vector<std::string>> parsed_commands; // Stores parsed commands, one per RESP array
 
-    // Parse function for RESP data types
-    std::string parse_bulk_string();
-    void parse_array();
-    
-    // Helper method to parse length prefix for bulk strings and arrays
-    int parse_length(const std::string& delimiter);
+    // Parse functions for RESP data types. Each reads from pos and advances it past what it
+    // consumed; they return false if the buffer ends before the value does
+    bool parse_bulk_string(size_t& pos, std::string& result);
+    bool parse_array(size_t& pos, std::vector<std::string>& command);
 
-    // Utility method to extract data until a delimiter
-    std::string parse_until(const std::string& delimiter, int length);
+    // Helper method to parse the length prefix of a bulk string or array
+    bool parse_length(size_t& pos, long long& length);
 
 public:
     RESPParser();
@@ -26,12 +25,12 @@ public:
     // Feed data into the parser
     void feed(const std::string& data);
 
-    // Parse the next complete RESP message (if available)
+    // Parse every complete RESP message; a trailing partial message stays buffered until more data is fed
     void parse();
 
-    // Retrieves parsed commands and clears the internal storage
-    std::vector<std::string> get_parsed_commands();
+    // Retrieves parsed commands (each a list of arguments) and clears the internal storage
+    std::vector<std::vector<std::string>> get_parsed_commands();
 };
 
 
-#endif
\ No newline at end of file
+#endif
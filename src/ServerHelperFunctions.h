@@ -3,29 +3,48 @@
 
 #include "RESPParser.h"
 #include "KeyValueStore.h"
+#include "PubSub.h"
+#include "ClientTracking.h"
 #include <iostream>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Per-connection state carried between commands
+struct ClientContext {
+    std::shared_ptr<Subscriber> subscriber;  // Created on the first (P)SUBSCRIBE
+
+    bool in_multi = false;                                     // Between MULTI and EXEC/DISCARD
+    std::vector<std::vector<std::string>> queued_commands;     // Commands queued by MULTI
+    bool multi_error = false;                                  // A command was rejected while queuing
+    std::unordered_map<std::string, uint64_t> watched_keys;    // WATCHed key -> version seen
+    std::string* reply_buffer = nullptr;                       // Collects replies while EXEC runs
+
+    uint64_t id = 0;              // Unique connection ID, reported by HELLO and CLIENT ID
+    int protocol = 2;             // RESP version negotiated with HELLO
+    bool tracking = false;        // CLIENT TRACKING is on
+    bool tracking_bcast = false;  // Tracking by prefix instead of by keys read
+};
 
 // Helper function to send responses
 void send_response(int client_socket, const std::string& response);
 
 // Helper function to send error messages
-void send_error(int client_socket, const char* error_msg) {
-    send(client_socket, error_msg, strlen(error_msg), 0);
-}
+void send_error(int client_socket, const char* error_msg);
 
 // Function to receive data from the client
 ssize_t receive_data(int client_socket, std::string& accumulated_data);
 
 // Function to process accumulated data with the parser
-void process_commands(std::string& accumulated_data, std::vector<std::string>& commands, RESPParser& parser);
+void process_commands(std::string& accumulated_data, std::vector<std::vector<std::string>>& commands, RESPParser& parser);
 
 // Function to handle each command and respond to the client
-bool handle_command(int client_socket, const std::vector<std::string>& commands, int argc, char** argv, KeyValueStore& store);
+bool handle_command(int client_socket, const std::vector<std::string>& commands, int argc, char** argv, KeyValueStore& store, ClientContext& client);
 
 void handle_client(int client_socket, int argc, char** argv);
 
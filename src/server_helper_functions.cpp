@@ -1,4 +1,11 @@
 #include "ServerHelperFunctions.h"
+#include "BitOps.h"
+#include "HyperLogLog.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <unordered_set>
 
 void send_response(int client_socket, const std::string& response) {
     send(client_socket, response.c_str(), response.length(), 0);
@@ -9,7 +16,7 @@ void send_error(int client_socket, const char* error_msg) {
 }
 
 ssize_t receive_data(int client_socket, std::string& accumulated_data) {
-  char buffer[1024];
+  char buffer[16 * 1024];
 
     // Receive data from the client
     ssize_t bytes_received = recv(client_socket, buffer, sizeof(buffer), 0);
@@ -20,7 +27,7 @@ ssize_t receive_data(int client_socket, std::string& accumulated_data) {
     return bytes_received;
 }
 
-void process_commands(std::string& accumulated_data, std::vector<std::string>& commands, RESPParser& parser) {
+void process_commands(std::string& accumulated_data, std::vector<std::vector<std::string>>& commands, RESPParser& parser) {
   // Feed accumulated data to the parser
   parser.feed(accumulated_data);
 
@@ -29,34 +36,235 @@ void process_commands(std::string& accumulated_data, std::vector<std::string>& c
       parser.parse();
 
       // Retrieve parsed commands and store them
-      std::vector<std::string> new_commands = parser.get_parsed_commands();
-      commands.insert(commands.end(), new_commands.begin(), new_commands.end());
+      std::vector<std::vector<std::string>> new_commands = parser.get_parsed_commands();
+      commands.insert(commands.end(), std::make_move_iterator(new_commands.begin()), std::make_move_iterator(new_commands.end()));
     }
     catch (const std::exception& e) {
       std::cerr << "Parsing error: " << e.what() << '\n';
     }
 }
 
-bool handle_command(int client_socket, const std::vector<std::string>& commands, int argc, char** argv, KeyValueStore& store) {
-    if (commands[0] == "PING") {
-        send_response(client_socket, "+PONG\r\n");
+// Commands handle_command understands; anything else is rejected when MULTI queues it
+static const std::unordered_set<std::string> known_commands = {
+    "PING", "ECHO", "SET", "GET", "DEL", "UNLINK", "FLUSHALL", "FLUSHDB", "CONFIG", "KEY", "INFO",
+    "MULTI", "EXEC", "DISCARD", "WATCH", "UNWATCH", "HELLO", "CLIENT", "PUBLISH",
+    "SUBSCRIBE", "UNSUBSCRIBE", "PSUBSCRIBE", "PUNSUBSCRIBE",
+    "SETBIT", "GETBIT", "BITCOUNT", "BITPOS", "BITOP", "PFADD", "PFCOUNT", "PFMERGE", "SAVE"};
+
+// Deliver a reply for this connection. During EXEC replies are collected into the EXEC
+// array; once it has a Subscriber, every reply goes through that queue so it can never
+// overtake queued Pub/Sub messages or confirmations
+static void reply(int client_socket, ClientContext& client, const std::string& response) {
+    if (client.reply_buffer) {
+        // Array elements must be real RESP frames, so "(error) ERR ..." becomes "-ERR ..."
+        static const std::string error_prefix = "(error) ";
+        if (response.compare(0, error_prefix.size(), error_prefix) == 0) {
+            client.reply_buffer->append("-" + response.substr(error_prefix.size()));
+        }
+        else {
+            client.reply_buffer->append(response);
+        }
+    }
+    else if (client.subscriber) {
+        if (!client.subscriber->enqueue_reply(std::make_shared<const std::string>(response))) {
+            std::cerr << "Dropped reply for client " << client.id << ": connection is closing.\n";
+        }
+    }
+    else {
+        send_response(client_socket, response);
+    }
+}
+
+// Release every WATCH held by the connection
+static void clear_watches(KeyValueStore& store, ClientContext& client) {
+    for (const auto& [key, seen_version] : client.watched_keys) {
+        store.unwatch(key);
+    }
+    client.watched_keys.clear();
+}
+
+// Register a read for CLIENT TRACKING before it happens, so a concurrent write still invalidates it
+static void track_read(ClientContext& client, const std::string& key) {
+    if (client.tracking && !client.tracking_bcast) {
+        ClientTracking::instance().remember_read(client.id, key);
+    }
+}
+
+// For tracking connections, hold the store lock from a read until its reply is queued.
+// Invalidations are queued under the same lock, so a reply can never arrive after the
+// invalidation of the value it carries
+static std::unique_lock<std::recursive_mutex> lock_for_tracked_read(KeyValueStore& store, ClientContext& client) {
+    return client.tracking ? store.lock() : std::unique_lock<std::recursive_mutex>();
+}
+
+// Resolve a Redis-style inclusive byte range (negative values count from the end).
+// Returns false if the range is empty
+static bool normalize_range(long long& start, long long& end, long long length) {
+    if (start < 0) start += length;
+    if (end < 0) end += length;
+    if (start < 0) start = 0;
+    if (end < 0) end = 0;
+    if (end >= length) end = length - 1;
+    return length > 0 && start <= end;
+}
+
+bool handle_command(int client_socket, const std::vector<std::string>& commands, int argc, char** argv, KeyValueStore& store, ClientContext& client) {
+    PubSub& pubsub = PubSub::instance();
+    bool subscribed = client.subscriber && pubsub.subscription_count(client.subscriber) > 0;
+
+    // A subscribed RESP2 connection only accepts subscription commands and PING; RESP3 tells
+    // messages apart from replies by their push type, so it allows everything
+    if (subscribed && client.protocol == 2 && commands[0] != "SUBSCRIBE" && commands[0] != "UNSUBSCRIBE" &&
+        commands[0] != "PSUBSCRIBE" && commands[0] != "PUNSUBSCRIBE" && commands[0] != "PING") {
+        reply(client_socket, client, "-ERR only (P)SUBSCRIBE / (P)UNSUBSCRIBE / PING are allowed in this context\r\n");
+        return true;
+    }
+
+    // Inside MULTI everything except the transaction commands is queued for EXEC
+    if (client.in_multi && commands[0] != "EXEC" && commands[0] != "DISCARD" &&
+        commands[0] != "MULTI" && commands[0] != "WATCH") {
+        // Reject commands that cannot produce exactly one reply inside EXEC; EXEC then aborts
+        if (!known_commands.count(commands[0])) {
+            client.multi_error = true;
+            reply(client_socket, client, "(error) ERR unknown command '" + commands[0] + "'\r\n");
+            return true;
+        }
+        if (commands[0] == "SUBSCRIBE" || commands[0] == "UNSUBSCRIBE" ||
+            commands[0] == "PSUBSCRIBE" || commands[0] == "PUNSUBSCRIBE") {
+            client.multi_error = true;
+            reply(client_socket, client, "(error) ERR Command not allowed inside a transaction\r\n");
+            return true;
+        }
+        client.queued_commands.push_back(commands);
+        reply(client_socket, client, "+QUEUED\r\n");
+        return true;
+    }
+
+    if (commands[0] == "MULTI") {
+        if (client.in_multi) {
+            reply(client_socket, client, "(error) ERR MULTI calls can not be nested\r\n");
+            return false;
+        }
+        client.in_multi = true;
+        reply(client_socket, client, "+OK\r\n");
+    }
+    else if (commands[0] == "EXEC") {
+        if (!client.in_multi) {
+            reply(client_socket, client, "(error) ERR EXEC without MULTI\r\n");
+            return false;
+        }
+        std::vector<std::vector<std::string>> queued;
+        queued.swap(client.queued_commands);
+        client.in_multi = false;
+
+        if (client.multi_error) {
+            client.multi_error = false;
+            clear_watches(store, client);
+            reply(client_socket, client, "-EXECABORT Transaction discarded because of previous errors.\r\n");
+            return true;
+        }
+
+        bool dirty = false;
+        std::string replies;
+        {
+            // One acquisition covers the WATCH check and every queued command. Replies are
+            // collected here and written after the lock is released, except for connections
+            // with a Subscriber: queueing never blocks, and queueing under the lock keeps the
+            // array ordered with invalidations of the keys it read
+            auto lock = store.lock();
+
+            for (const auto& [key, seen_version] : client.watched_keys) {
+                if (store.version(key) != seen_version) {
+                    dirty = true;
+                    break;
+                }
+            }
+
+            if (!dirty) {
+                client.reply_buffer = &replies;
+                for (const auto& queued_command : queued) {
+                    size_t before = replies.size();
+                    try {
+                        handle_command(client_socket, queued_command, argc, argv, store, client);
+                    }
+                    catch (const std::exception& e) {
+                        // A failed command takes an error slot; the rest of the transaction still runs
+                        replies.resize(before);
+                        replies += "-ERR " + std::string(e.what()) + "\r\n";
+                    }
+                    // Keep the EXEC array aligned even if a command wrote nothing
+                    if (replies.size() == before) {
+                        replies += "$-1\r\n";
+                    }
+                }
+                client.reply_buffer = nullptr;
+            }
+            if (!client.subscriber) {
+                lock.unlock();
+            }
+            clear_watches(store, client);
+
+            if (dirty) {
+                reply(client_socket, client, "*-1\r\n");
+            }
+            else {
+                reply(client_socket, client, "*" + std::to_string(queued.size()) + "\r\n" + replies);
+            }
+        }
+    }
+    else if (commands[0] == "DISCARD") {
+        if (!client.in_multi) {
+            reply(client_socket, client, "(error) ERR DISCARD without MULTI\r\n");
+            return false;
+        }
+        client.in_multi = false;
+        client.multi_error = false;
+        client.queued_commands.clear();
+        clear_watches(store, client);
+        reply(client_socket, client, "+OK\r\n");
+    }
+    else if (commands[0] == "WATCH") {
+        if (commands.size() < 2) {
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+            return false;
+        }
+        if (client.in_multi) {
+            reply(client_socket, client, "(error) ERR WATCH inside MULTI is not allowed\r\n");
+            return false;
+        }
+        for (size_t i = 1; i < commands.size(); ++i) {
+            // Keep the first version seen if a key is watched twice
+            if (!client.watched_keys.count(commands[i])) {
+                client.watched_keys[commands[i]] = store.watch(commands[i]);
+            }
+        }
+        reply(client_socket, client, "+OK\r\n");
+    }
+    else if (commands[0] == "UNWATCH") {
+        clear_watches(store, client);
+        reply(client_socket, client, "+OK\r\n");
+    }
+    else if (commands[0] == "PING") {
+        // RESP3 has no subscribed context, so PING answers normally there
+        bool pong_array = subscribed && client.protocol == 2;
+        reply(client_socket, client, pong_array ? "*2\r\n$4\r\npong\r\n$0\r\n\r\n" : "+PONG\r\n");
     }
     else if (commands[0] == "ECHO") {
         if (commands.size() != 2) {
-            send_error(client_socket, "(error) ERR wrong number of arguments for command\r\n");
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
             return false;
         }
         std::string response = "$" + std::to_string(commands[1].size()) + "\r\n" + commands[1] + "\r\n";
-        send_response(client_socket, response);
+        reply(client_socket, client, response);
     }
     else if (commands[0] == "SET") {
         if (commands.size() < 3) {
-            send_error(client_socket, "(error) ERR wrong number of arguments for command\r\n");
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
             return false;
         }
         else if (commands.size() == 3) {
             store.set(commands[1], commands[2]);
-            send_response(client_socket, "+OK\r\n");
+            reply(client_socket, client, "+OK\r\n");
         }
         else if (commands.size() == 5 && commands[3] == "px") {
             int expiry;
@@ -64,64 +272,628 @@ bool handle_command(int client_socket, const std::vector<std::string>& commands,
                 expiry = std::stoi(commands[4]);
             }
             catch (...) {
-                send_error(client_socket, "(error) ERR invalid expiry time in PX\r\n");
+                reply(client_socket, client, "(error) ERR invalid expiry time in PX\r\n");
                 return false;
             }
             store.set(commands[1], commands[2], expiry);
-            send_response(client_socket, "+OK\r\n");
+            reply(client_socket, client, "+OK\r\n");
         }
         else {
-            send_error(client_socket, "(error) ERR syntax error\r\n");
+            reply(client_socket, client, "(error) ERR syntax error\r\n");
             return false;
         }
     }
     else if (commands[0] == "GET") {
         if (commands.size() != 2) {
-            send_error(client_socket, "(error) ERR wrong number of arguments for command\r\n");
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+            return false;
+        }
+        auto tracked_read_lock = lock_for_tracked_read(store, client);
+        track_read(client, commands[1]);
+        std::string response;
+        store.read(commands[1], [&](const std::string* value) {
+            if (!value) {
+                response = client.protocol == 3 ? "_\r\n" : "$-1\r\n";
+            }
+            else {
+                response = "$" + std::to_string(value->size()) + "\r\n" + *value + "\r\n";
+            }
+        });
+        reply(client_socket, client, response);
+    }
+    else if (commands[0] == "SETBIT") {
+        if (commands.size() != 4) {
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
             return false;
         }
-        if (!store.exists(commands[1])) {
-            send_response(client_socket, "$-1\r\n");
+        long long offset;
+        try {
+            offset = std::stoll(commands[2]);
         }
+        catch (...) {
+            offset = -1;
+        }
+        // Bitmaps are capped at 512MB like Redis
+        if (offset < 0 || offset >= (1LL << 32)) {
+            reply(client_socket, client, "(error) ERR bit offset is not an integer or out of range\r\n");
+            return false;
+        }
+        if (commands[3] != "0" && commands[3] != "1") {
+            reply(client_socket, client, "(error) ERR bit is not an integer or out of range\r\n");
+            return false;
+        }
+        int bit = commands[3] == "1";
+        int old_bit = 0;
+        store.modify(commands[1], [&](std::string& value) {
+            size_t byte = static_cast<size_t>(offset >> 3);
+            bool grew = value.size() <= byte;
+            if (grew) {
+                value.resize(byte + 1, '\0');
+            }
+            uint8_t mask = static_cast<uint8_t>(0x80 >> (offset & 7));
+            old_bit = (static_cast<uint8_t>(value[byte]) & mask) ? 1 : 0;
+            if (old_bit != bit) {
+                value[byte] = static_cast<char>(value[byte] ^ mask);
+            }
+            return grew || old_bit != bit;
+        });
+        reply(client_socket, client, ":" + std::to_string(old_bit) + "\r\n");
+    }
+    else if (commands[0] == "GETBIT") {
+        if (commands.size() != 3) {
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+            return false;
+        }
+        long long offset;
+        try {
+            offset = std::stoll(commands[2]);
+        }
+        catch (...) {
+            offset = -1;
+        }
+        if (offset < 0 || offset >= (1LL << 32)) {
+            reply(client_socket, client, "(error) ERR bit offset is not an integer or out of range\r\n");
+            return false;
+        }
+        auto tracked_read_lock = lock_for_tracked_read(store, client);
+        track_read(client, commands[1]);
+        int bit = 0;
+        store.read(commands[1], [&](const std::string* value) {
+            size_t byte = static_cast<size_t>(offset >> 3);
+            if (value && byte < value->size()) {
+                bit = (static_cast<uint8_t>((*value)[byte]) >> (7 - (offset & 7))) & 1;
+            }
+        });
+        reply(client_socket, client, ":" + std::to_string(bit) + "\r\n");
+    }
+    else if (commands[0] == "BITCOUNT" || commands[0] == "BITPOS") {
+        bool is_pos = commands[0] == "BITPOS";
+        size_t first_range_arg = is_pos ? 3 : 2;
+        if (commands.size() < first_range_arg || commands.size() > first_range_arg + 3) {
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+            return false;
+        }
+        if (is_pos && commands[2] != "0" && commands[2] != "1") {
+            reply(client_socket, client, "(error) ERR The bit argument must be 1 or 0.\r\n");
+            return false;
+        }
+
+        // Only byte ranges are supported; an explicit BYTE unit is accepted
+        std::vector<std::string> range(commands.begin() + first_range_arg, commands.end());
+        if (range.size() == 3) {
+            if (range[2] != "BYTE" && range[2] != "byte") {
+                reply(client_socket, client, "(error) ERR syntax error\r\n");
+                return false;
+            }
+            range.pop_back();
+        }
+        if (!is_pos && range.size() == 1) {
+            reply(client_socket, client, "(error) ERR syntax error\r\n");
+            return false;
+        }
+        long long start = 0;
+        long long end = -1;
+        try {
+            if (range.size() >= 1) start = std::stoll(range[0]);
+            if (range.size() >= 2) end = std::stoll(range[1]);
+        }
+        catch (...) {
+            reply(client_socket, client, "(error) ERR value is not an integer or out of range\r\n");
+            return false;
+        }
+
+        auto tracked_read_lock = lock_for_tracked_read(store, client);
+        track_read(client, commands[1]);
+        int bit = is_pos && commands[2] == "1";
+        long long result = is_pos ? (bit ? -1 : 0) : 0;
+        store.read(commands[1], [&](const std::string* value) {
+            if (!value) {
+                return;
+            }
+            long long length = static_cast<long long>(value->size());
+            if (!normalize_range(start, end, length)) {
+                result = is_pos ? -1 : 0;
+                return;
+            }
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(value->data()) + start;
+            size_t span = static_cast<size_t>(end - start + 1);
+            if (!is_pos) {
+                result = static_cast<long long>(bit_count(bytes, span));
+                return;
+            }
+            int64_t position = bit_position(bytes, span, bit);
+            if (position >= 0) {
+                result = start * 8 + position;
+            }
+            else if (!bit && range.size() < 2) {
+                // Looking for a clear bit with no explicit end: the string is treated as zero-padded
+                result = (end + 1) * 8;
+            }
+            else {
+                result = -1;
+            }
+        });
+        reply(client_socket, client, ":" + std::to_string(result) + "\r\n");
+    }
+    else if (commands[0] == "BITOP") {
+        if (commands.size() < 4) {
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+            return false;
+        }
+        std::string op_name = commands[1];
+        for (char& c : op_name) {
+            c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+        }
+        BitOp op;
+        if (op_name == "AND") op = BitOp::And;
+        else if (op_name == "OR") op = BitOp::Or;
+        else if (op_name == "XOR") op = BitOp::Xor;
+        else if (op_name == "NOT") op = BitOp::Not;
         else {
-            std::string value = store.get(commands[1]);
-            std::string response = "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
-            send_response(client_socket, response);
+            reply(client_socket, client, "(error) ERR syntax error\r\n");
+            return false;
+        }
+        if (op == BitOp::Not && commands.size() != 4) {
+            reply(client_socket, client, "(error) ERR BITOP NOT must be called with a single source key.\r\n");
+            return false;
+        }
+
+        const std::string& dest = commands[2];
+        size_t result_length = 0;
+        std::string result;
+        {
+            // Sources are read and the destination written under one store lock
+            auto lock = store.lock();
+            for (size_t i = 3; i < commands.size(); ++i) {
+                store.read(commands[i], [&](const std::string* value) {
+                    if (value) {
+                        result_length = std::max(result_length, value->size());
+                    }
+                });
+            }
+
+            // Shorter sources behave as if zero-padded to the longest one
+            result.assign(result_length, '\0');
+            uint8_t* out = reinterpret_cast<uint8_t*>(result.data());
+            for (size_t i = 3; i < commands.size(); ++i) {
+                store.read(commands[i], [&](const std::string* value) {
+                    size_t length = value ? value->size() : 0;
+                    const uint8_t* in = value ? reinterpret_cast<const uint8_t*>(value->data()) : nullptr;
+                    if (op == BitOp::Not) {
+                        bit_op(BitOp::Not, out, in, length);
+                    }
+                    else if (i == 3) {
+                        if (length > 0) {
+                            std::memcpy(out, in, length);
+                        }
+                    }
+                    else {
+                        bit_op(op, out, in, length);
+                        if (op == BitOp::And) {
+                            std::memset(out + length, 0, result_length - length);
+                        }
+                    }
+                });
+            }
+
+            if (result.empty()) {
+                store.del(dest);
+            }
+            else {
+                store.modify(dest, [&](std::string& value) {
+                    value.swap(result);
+                    return true;
+                });
+                // The result replaces the destination outright, so its old TTL no longer applies
+                store.persist(dest);
+            }
         }
+        // Any previous destination value was swapped into result and is released here, outside the lock
+        reply(client_socket, client, ":" + std::to_string(result_length) + "\r\n");
+    }
+    else if (commands[0] == "PFADD") {
+        if (commands.size() < 2) {
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+            return false;
+        }
+        bool wrong_type = false;
+        bool changed = false;
+        {
+            auto lock = store.lock();
+            store.read(commands[1], [&](const std::string* value) {
+                wrong_type = value && !HyperLogLog::is_valid(*value);
+            });
+            if (!wrong_type) {
+                changed = store.modify(commands[1], [&](std::string& value) {
+                    if (value.empty()) {
+                        value = HyperLogLog::create();
+                    }
+                    bool updated = false;
+                    for (size_t i = 2; i < commands.size(); ++i) {
+                        updated |= HyperLogLog::add(value, commands[i]);
+                    }
+                    return updated;
+                });
+            }
+        }
+        if (wrong_type) {
+            reply(client_socket, client, "(error) WRONGTYPE Key is not a valid HyperLogLog string value.\r\n");
+            return false;
+        }
+        reply(client_socket, client, changed ? ":1\r\n" : ":0\r\n");
+    }
+    else if (commands[0] == "PFCOUNT" || commands[0] == "PFMERGE") {
+        if (commands.size() < 2) {
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+            return false;
+        }
+        bool is_merge = commands[0] == "PFMERGE";
+        bool wrong_type = false;
+        uint64_t cardinality = 0;
+        std::vector<uint8_t> registers(HyperLogLog::HLL_REGISTERS, 0);
+        auto tracked_read_lock = lock_for_tracked_read(store, client);
+        {
+            // PFMERGE folds the destination in too, so it is simply the first key
+            auto lock = store.lock();
+            for (size_t i = 1; i < commands.size() && !wrong_type; ++i) {
+                if (!is_merge) {
+                    track_read(client, commands[i]);
+                }
+                store.read(commands[i], [&](const std::string* value) {
+                    if (!value) {
+                        return;
+                    }
+                    if (!HyperLogLog::is_valid(*value)) {
+                        wrong_type = true;
+                        return;
+                    }
+                    HyperLogLog::merge_into(registers.data(), *value);
+                });
+            }
+            if (!wrong_type && is_merge) {
+                store.modify(commands[1], [&](std::string& value) {
+                    HyperLogLog::store_dense(value, registers.data());
+                    return true;
+                });
+            }
+        }
+        if (wrong_type) {
+            reply(client_socket, client, "(error) WRONGTYPE Key is not a valid HyperLogLog string value.\r\n");
+            return false;
+        }
+        if (is_merge) {
+            reply(client_socket, client, "+OK\r\n");
+        }
+        else {
+            cardinality = HyperLogLog::count(registers.data());
+            reply(client_socket, client, ":" + std::to_string(cardinality) + "\r\n");
+        }
+    }
+    else if (commands[0] == "DEL" || commands[0] == "UNLINK") {
+        if (commands.size() < 2) {
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+            return false;
+        }
+        // UNLINK only detaches the key; large values are reclaimed in the background
+        bool lazy = commands[0] == "UNLINK";
+        int removed = 0;
+        for (size_t i = 1; i < commands.size(); ++i) {
+            if (lazy ? store.unlink(commands[i]) : store.del(commands[i])) {
+                ++removed;
+            }
+        }
+        reply(client_socket, client, ":" + std::to_string(removed) + "\r\n");
+    }
+    else if (commands[0] == "FLUSHALL" || commands[0] == "FLUSHDB") {
+        bool async = false;
+        if (commands.size() == 2 && commands[1] == "ASYNC") {
+            async = true;
+        }
+        else if (commands.size() > 2 || (commands.size() == 2 && commands[1] != "SYNC")) {
+            reply(client_socket, client, "(error) ERR syntax error\r\n");
+            return false;
+        }
+        store.flush(async);
+        reply(client_socket, client, "+OK\r\n");
+    }
+    else if (commands[0] == "SUBSCRIBE" || commands[0] == "PSUBSCRIBE") {
+        if (commands.size() < 2) {
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+            return false;
+        }
+        if (!client.subscriber) {
+            client.subscriber = std::make_shared<Subscriber>(client_socket);
+            client.subscriber->protocol = client.protocol;
+        }
+        bool is_pattern = commands[0] == "PSUBSCRIBE";
+        std::string kind = is_pattern ? "psubscribe" : "subscribe";
+        std::string header = client.protocol == 3 ? ">3\r\n" : "*3\r\n";
+        for (size_t i = 1; i < commands.size(); ++i) {
+            size_t count = is_pattern ? pubsub.psubscribe(client.subscriber, commands[i])
+                                      : pubsub.subscribe(client.subscriber, commands[i]);
+            std::string response = header + "$" + std::to_string(kind.size()) + "\r\n" + kind + "\r\n" +
+                                   "$" + std::to_string(commands[i].size()) + "\r\n" + commands[i] + "\r\n" +
+                                   ":" + std::to_string(count) + "\r\n";
+            reply(client_socket, client, response);
+        }
+    }
+    else if (commands[0] == "UNSUBSCRIBE" || commands[0] == "PUNSUBSCRIBE") {
+        bool is_pattern = commands[0] == "PUNSUBSCRIBE";
+        std::string kind = is_pattern ? "punsubscribe" : "unsubscribe";
+        std::string header = client.protocol == 3 ? ">3\r\n" : "*3\r\n";
+        std::vector<std::string> targets(commands.begin() + 1, commands.end());
+        if (targets.empty() && client.subscriber) {
+            // No arguments: drop every subscription of this kind
+            std::set<std::string> current = is_pattern ? pubsub.patterns_of(client.subscriber)
+                                                       : pubsub.channels_of(client.subscriber);
+            targets.assign(current.begin(), current.end());
+        }
+        if (targets.empty()) {
+            std::string response = header + "$" + std::to_string(kind.size()) + "\r\n" + kind + "\r\n$-1\r\n:0\r\n";
+            reply(client_socket, client, response);
+        }
+        else if (!client.subscriber) {
+            // Never subscribed: there is nothing to remove
+            for (const std::string& target : targets) {
+                std::string response = header + "$" + std::to_string(kind.size()) + "\r\n" + kind + "\r\n" +
+                                       "$" + std::to_string(target.size()) + "\r\n" + target + "\r\n:0\r\n";
+                reply(client_socket, client, response);
+            }
+        }
+        else {
+            for (const std::string& target : targets) {
+                size_t count = is_pattern ? pubsub.punsubscribe(client.subscriber, target)
+                                          : pubsub.unsubscribe(client.subscriber, target);
+                std::string response = header + "$" + std::to_string(kind.size()) + "\r\n" + kind + "\r\n" +
+                                       "$" + std::to_string(target.size()) + "\r\n" + target + "\r\n" +
+                                       ":" + std::to_string(count) + "\r\n";
+                reply(client_socket, client, response);
+            }
+        }
+    }
+    else if (commands[0] == "PUBLISH") {
+        if (commands.size() != 3) {
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+            return false;
+        }
+        size_t receivers = pubsub.publish(commands[1], commands[2]);
+        reply(client_socket, client, ":" + std::to_string(receivers) + "\r\n");
+    }
+    else if (commands[0] == "HELLO") {
+        if (commands.size() >= 2) {
+            int protocol = 0;
+            try {
+                protocol = std::stoi(commands[1]);
+            }
+            catch (...) {
+            }
+            if (protocol != 2 && protocol != 3) {
+                reply(client_socket, client, "(error) NOPROTO unsupported protocol version\r\n");
+                return false;
+            }
+            if (client.tracking && protocol == 2) {
+                // Invalidation pushes can only be delivered over RESP3
+                reply(client_socket, client, "(error) ERR cannot switch to RESP2 while client tracking is on\r\n");
+                return false;
+            }
+            client.protocol = protocol;
+            if (client.subscriber) {
+                client.subscriber->protocol = protocol;
+            }
+        }
+
+        std::string id = std::to_string(client.id);
+        std::string fields = "$6\r\nserver\r\n$5\r\nredis\r\n"
+                             "$7\r\nversion\r\n$5\r\n7.2.0\r\n"
+                             "$5\r\nproto\r\n:" + std::to_string(client.protocol) + "\r\n"
+                             "$2\r\nid\r\n:" + id + "\r\n"
+                             "$4\r\nmode\r\n$10\r\nstandalone\r\n"
+                             "$4\r\nrole\r\n$6\r\nmaster\r\n"
+                             "$7\r\nmodules\r\n*0\r\n";
+        reply(client_socket, client, (client.protocol == 3 ? "%7\r\n" : "*14\r\n") + fields);
+    }
+    else if (commands[0] == "CLIENT") {
+        if (commands.size() < 2) {
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+            return false;
+        }
+        auto upper = [](std::string word) {
+            for (char& c : word) {
+                c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+            }
+            return word;
+        };
+
+        std::string subcommand = upper(commands[1]);
+        if (subcommand == "ID") {
+            reply(client_socket, client, ":" + std::to_string(client.id) + "\r\n");
+        }
+        else if (subcommand == "TRACKING") {
+            if (commands.size() < 3) {
+                reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+                return false;
+            }
+            std::string mode = upper(commands[2]);
+            if (mode == "OFF") {
+                ClientTracking::instance().disable(client.id);
+                client.tracking = false;
+                client.tracking_bcast = false;
+                reply(client_socket, client, "+OK\r\n");
+                return true;
+            }
+            if (mode != "ON") {
+                reply(client_socket, client, "(error) ERR syntax error\r\n");
+                return false;
+            }
+
+            bool bcast = false;
+            std::vector<std::string> prefixes;
+            for (size_t i = 3; i < commands.size(); ++i) {
+                std::string option = upper(commands[i]);
+                if (option == "BCAST") {
+                    bcast = true;
+                }
+                else if (option == "PREFIX" && i + 1 < commands.size()) {
+                    prefixes.push_back(commands[++i]);
+                }
+                else {
+                    reply(client_socket, client, "(error) ERR syntax error\r\n");
+                    return false;
+                }
+            }
+            if (!bcast && !prefixes.empty()) {
+                reply(client_socket, client, "(error) ERR PREFIX option requires BCAST mode to be enabled\r\n");
+                return false;
+            }
+            // A key matching two of a client's prefixes would be invalidated twice
+            for (size_t i = 0; i < prefixes.size(); ++i) {
+                for (size_t j = i + 1; j < prefixes.size(); ++j) {
+                    const std::string& shorter = prefixes[i].size() <= prefixes[j].size() ? prefixes[i] : prefixes[j];
+                    const std::string& longer = prefixes[i].size() <= prefixes[j].size() ? prefixes[j] : prefixes[i];
+                    if (longer.compare(0, shorter.size(), shorter) == 0) {
+                        reply(client_socket, client, "(error) ERR Prefix '" + longer + "' overlaps with another provided prefix '" +
+                                                         shorter + "'. Prefixes for a single client must not overlap.\r\n");
+                        return false;
+                    }
+                }
+            }
+            if (client.protocol != 3) {
+                reply(client_socket, client, "(error) ERR client tracking requires RESP3, send HELLO 3 first\r\n");
+                return false;
+            }
+
+            // Pushes share the connection's asynchronous output queue with Pub/Sub
+            if (!client.subscriber) {
+                client.subscriber = std::make_shared<Subscriber>(client_socket);
+                client.subscriber->protocol = client.protocol;
+            }
+            ClientTracking::instance().enable(client.id, client.subscriber, bcast, std::move(prefixes));
+            client.tracking = true;
+            client.tracking_bcast = bcast;
+            reply(client_socket, client, "+OK\r\n");
+        }
+        else {
+            reply(client_socket, client, "(error) ERR unknown CLIENT subcommand\r\n");
+            return false;
+        }
+    }
+    else if (commands[0] == "CONFIG" && commands.size() < 2) {
+        reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+        return false;
+    }
+    else if (commands[0] == "CONFIG" && commands[1] == "SET") {
+        if (commands.size() != 4) {
+            reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
+            return false;
+        }
+        CompressionStats current = store.compression_stats();
+        if (commands[2] == "value-compression" && (commands[3] == "yes" || commands[3] == "no")) {
+            store.set_compression(commands[3] == "yes", current.threshold);
+        }
+        else if (commands[2] == "value-compression-threshold") {
+            long long threshold;
+            try {
+                threshold = std::stoll(commands[3]);
+            }
+            catch (...) {
+                threshold = 0;
+            }
+            if (threshold <= 0) {
+                reply(client_socket, client, "(error) ERR invalid value-compression-threshold\r\n");
+                return false;
+            }
+            store.set_compression(current.enabled, static_cast<size_t>(threshold));
+        }
+        else {
+            reply(client_socket, client, "(error) ERR Unsupported CONFIG parameter\r\n");
+            return false;
+        }
+        reply(client_socket, client, "+OK\r\n");
+    }
+    else if (commands[0] == "INFO") {
+        CompressionStats stats = store.compression_stats();
+        double ratio = stats.stored_bytes > 0 ? static_cast<double>(stats.original_bytes) / stats.stored_bytes : 1.0;
+        char ratio_text[32];
+        snprintf(ratio_text, sizeof(ratio_text), "%.2f", ratio);
+
+        std::string info = "# Compression\r\n"
+                           "value_compression:" + std::string(stats.enabled ? "yes" : "no") + "\r\n"
+                           "value_compression_threshold:" + std::to_string(stats.threshold) + "\r\n"
+                           "compressed_values:" + std::to_string(stats.values) + "\r\n"
+                           "compressed_original_bytes:" + std::to_string(stats.original_bytes) + "\r\n"
+                           "compressed_stored_bytes:" + std::to_string(stats.stored_bytes) + "\r\n"
+                           "compression_ratio:" + ratio_text + "\r\n";
+        reply(client_socket, client, "$" + std::to_string(info.size()) + "\r\n" + info + "\r\n");
     }
     else if(commands[0] == "CONFIG" && commands[1] == "GET") {
         if(commands.size() < 3) {
-        send_error(client_socket, "(error) ERR wrong number of arguments for command\r\n");
+        reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
         return false;
         }
         // Check if there are sufficient command-line arguments (argc should be at least 5)
         if(argc < 5) {
         // Send an error message to the client
-        std::string error_msg = "(error) ERR missing command-line arguments.\n";
-        error_msg += "Expected usage: ./your_program.sh --dir <directory> --dbfilename <filename>\n";
-        send_error(client_socket, error_msg.c_str());
+        std::string error_msg = "(error) ERR missing command-line arguments. ";
+        error_msg += "Expected usage: ./your_program.sh --dir <directory> --dbfilename <filename>\r\n";
+        reply(client_socket, client, error_msg.c_str());
         return false;
         }
 
         if(commands[2] == "dir") {
         std::string response = "*2\r\n$3\r\ndir\r\n$" + std::to_string(strlen(argv[2])) + "\r\n" + argv[2] + "\r\n";
-        send_response(client_socket, response); 
+        reply(client_socket, client, response); 
         }
         else if(commands[2] == "dbfilename") {
         std::string response = "*2\r\n$10\r\n$" + std::to_string(strlen(argv[4])) + "\r\n" + argv[4] + "\r\n";
-        send_response(client_socket, response);
+        reply(client_socket, client, response);
+        }
+    }
+    else if(commands[0] == "SAVE") {
+        if(argc < 5) {
+        std::string error_msg = "(error) ERR missing command-line arguments. ";
+        error_msg += "Expected usage: ./your_program.sh --dir <directory> --dbfilename <filename>\r\n";
+        reply(client_socket, client, error_msg.c_str());
+        return false;
         }
+
+        // Compressed values go into the snapshot as they are stored, without recompressing
+        std::string path = std::string(argv[2]) + "/" + argv[4];
+        if(!store.save_rdb(path)) {
+        reply(client_socket, client, "(error) ERR failed to write " + path + "\r\n");
+        return false;
+        }
+        reply(client_socket, client, "+OK\r\n");
     }
     else if(commands[0] == "KEY") {
         if(commands.size() != 2) {
-        send_error(client_socket, "(error) ERR wrong number of arguments for command\r\n");
+        reply(client_socket, client, "(error) ERR wrong number of arguments for command\r\n");
         return false;
         }
         // Check if there are sufficient command-line arguments (argc should be at least 5)
         if(argc < 5) {
-        std::string error_msg = "(error) ERR missing command-line arguments.\n";
-        error_msg += "Expected usage: ./your_program.sh --dir <directory> --dbfilename <filename>\n";
-        send_error(client_socket, error_msg.c_str());
+        std::string error_msg = "(error) ERR missing command-line arguments. ";
+        error_msg += "Expected usage: ./your_program.sh --dir <directory> --dbfilename <filename>\r\n";
+        reply(client_socket, client, error_msg.c_str());
         return false;
         }
 
@@ -138,10 +910,13 @@ bool handle_command(int client_socket, const std::vector<std::string>& commands,
 
 void handle_client(int client_socket, int argc, char** argv) {
   RESPParser parser;    // Parser instance
-  KeyValueStore store;  // Store instance
+  static KeyValueStore store;  // Store instance shared by every client
+  static std::atomic<uint64_t> next_client_id{1};
+  ClientContext client;        // Per-connection state
+  client.id = next_client_id++;
 
   std::string accumulated_data;
-  std::vector<std::string> commands;
+  std::vector<std::vector<std::string>> commands;
 
   // Continuously handle client requests
   while(true) {
@@ -155,9 +930,22 @@ void handle_client(int client_socket, int argc, char** argv) {
     // Process data and parse commands
     process_commands(accumulated_data, commands, parser);
 
-    // Execute command and respond
-    if (!commands.empty()) {
-        if (!handle_command(client_socket, commands, argc, argv, store)) {
+    // Execute each pipelined command in order and respond
+    bool keep_open = true;
+    for (const auto& command : commands) {
+        if (command.empty()) {
+            continue;
+        }
+        try {
+            keep_open = handle_command(client_socket, command, argc, argv, store, client);
+        }
+        catch (const std::exception& e) {
+            // e.g. a stored value that failed to decompress
+            std::cerr << "Command failed: " << e.what() << '\n';
+            reply(client_socket, client, "(error) ERR " + std::string(e.what()) + "\r\n");
+            keep_open = false;
+        }
+        if (!keep_open) {
             break;
         }
     }
@@ -165,6 +953,21 @@ void handle_client(int client_socket, int argc, char** argv) {
     // After processing, clear accumulated data and parsed commands
     accumulated_data.clear();
     commands.clear();
+    if (!keep_open) {
+      break;
+    }
+  }
+
+  clear_watches(store, client);
+
+  // Drop subscriptions and tracking, and make the writer let go of the socket before it is closed
+  if (client.tracking) {
+    ClientTracking::instance().disable(client.id);
+  }
+  if (client.subscriber) {
+    PubSub::instance().unsubscribe_all(client.subscriber);
+    client.subscriber->close();
+    client.subscriber.reset();
   }
 
   // Close the client socket when don